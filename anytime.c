@@ -0,0 +1,248 @@
+#include "anytime.h"
+
+#include <time.h>
+
+/**
+ * Anytime search (ARA*).
+ *
+ * A* with the heuristic multiplied by some epsilon >= 1 expands far fewer
+ * pixels than Dijkstra, and finds a path costing at most epsilon times the
+ * optimum. findPathAnytime() first searches with ANYTIME_EPSILON, then
+ * keeps lowering epsilon and searching again until it reaches 1 (an
+ * optimal path) or runs out of time. Each pass reuses the costs found by
+ * the previous ones: only pixels whose cost went down since they were last
+ * expanded (kept on an "inconsistent" list) are put back in the heap.
+ *
+ * The heuristic is the landmark bound if `lm` is given, otherwise
+ * `minStep` times the Manhattan distance, where `minStep` must be no more
+ * than the cheapest step the weight function can return (0 turns the
+ * search into Dijkstra, which is still correct, just slow).
+ */
+
+// Everything one anytime search keeps between passes
+typedef struct
+{
+  Image *im;
+  WeightFunc weight;
+  Landmarks *lm;
+  double minStep;
+  int target;
+
+  double *g;    // Best known cost to each pixel (INFINITY if not reached)
+  double *h;    // Heuristic, only valid once g[] is finite
+  int *parent;
+  int *closed;  // closed[p] == pass if p was expanded this pass, -pass if
+                //   it has also been put on `incons` since
+  int *incons;  // Expanded pixels whose g[] has dropped since
+  int numIncons;
+  MinHeap *open;
+} AnytimeSearch;
+
+static double elapsedMs(struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1e3 +
+         (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static double heuristic(AnytimeSearch *s, int p)
+{
+  int sx = s->im->sx;
+  int dx = abs(p % sx - s->target % sx), dy = abs(p / sx - s->target / sx);
+  double h = s->minStep * (dx + dy);
+  if (s->lm)
+  {
+    double l = landmarkHeuristic(s->lm, p, s->target);
+    if (l > h)
+      h = l;
+  }
+  return h;
+}
+
+/**
+ * One ARA* pass: expand pixels in order of g + epsilon * h until the target
+ * is no worse than anything left in the heap. Returns 0 if the time ran out
+ * first.
+ */
+static int improvePath(AnytimeSearch *s, double epsilon, int pass,
+                       struct timespec *start, double budgetMs)
+{
+  int sx = s->im->sx, sy = s->im->sy;
+  MinHeap *open = s->open;
+  int expanded = 0;
+
+  while (open->numItems != 0 && open->arr[0].priority < s->g[s->target])
+  {
+    // Don't ask the clock on every pixel
+    if ((++expanded & 1023) == 0 && elapsedMs(start) > budgetMs)
+      return 0;
+
+    double priority;
+    int p = heapExtractMin(open, &priority);
+    s->closed[p] = pass;
+
+    int x = p % sx, y = p / sx;
+    int neighbours[4], count = 0;
+    if (x > 0)
+      neighbours[count++] = p - 1;
+    if (y > 0)
+      neighbours[count++] = p - sx;
+    if (x < sx - 1)
+      neighbours[count++] = p + 1;
+    if (y < sy - 1)
+      neighbours[count++] = p + sx;
+
+    for (int i = 0; i < count; i++)
+    {
+      int q = neighbours[i];
+      double total = s->g[p] + s->weight(s->im, p, q);
+      if (!(total < s->g[q]))
+        continue;
+
+      if (s->g[q] == INFINITY)
+        s->h[q] = heuristic(s, q);
+      s->g[q] = total;
+      s->parent[q] = p;
+
+      if (s->closed[q] == pass)
+      {
+        // Already expanded in this pass, leave it for the next one, and
+        // mark it so it only goes on the list once
+        s->incons[s->numIncons++] = q;
+        s->closed[q] = -pass;
+      }
+      else if (s->closed[q] == -pass)
+        ; // Already on the list
+      else if (open->indices[q] == -1)
+        heapPush(open, q, total + epsilon * s->h[q]);
+      else
+        heapDecreasePriority(open, q, total + epsilon * s->h[q]);
+    }
+  }
+  return 1;
+}
+
+/**
+ * Copy the current path to the target into `path` (ending with -1), and
+ * return its actual cost.
+ */
+static double publishPath(AnytimeSearch *s, int path[])
+{
+  int n = 0;
+  for (int p = s->target; p != -1; p = s->parent[p])
+    n++;
+  path[n] = -1;
+
+  double cost = 0.0;
+  int p = s->target;
+  for (int i = n - 1; i >= 0; i--, p = s->parent[p])
+  {
+    path[i] = p;
+    if (s->parent[p] != -1)
+      cost += s->weight(s->im, s->parent[p], p);
+  }
+  return cost;
+}
+
+/**
+ * Find a path from `source` to `target`, spending at most about `budgetMs`
+ * milliseconds, and write the best one found to `path` like findPath()
+ * (ending with -1). Returns its cost, and sets `*bound` (if not NULL) to a
+ * factor by which it can be at most more expensive than the optimal path
+ * (1 if it is optimal).
+ *
+ * If the first pass does not finish in time, there is no path: `path` is
+ * left empty, and INFINITY is returned.
+ */
+double findPathAnytime(Image *im, WeightFunc weight, Landmarks *lm,
+                       double minStep, int source, int target,
+                       double budgetMs, int path[], double *bound)
+{
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  int numPixels = im->sx * im->sy;
+  AnytimeSearch s = {im, weight, lm, minStep, target};
+  s.g = malloc(sizeof(double) * numPixels);
+  s.h = malloc(sizeof(double) * numPixels);
+  s.parent = malloc(sizeof(int) * numPixels);
+  s.closed = calloc(sizeof(int), numPixels);
+  s.incons = malloc(sizeof(int) * numPixels);
+  s.open = newMinHeap(numPixels);
+  int *vals = malloc(sizeof(int) * numPixels);
+  double *priorities = malloc(sizeof(double) * numPixels);
+  if (s.g == NULL || s.h == NULL || s.parent == NULL || s.closed == NULL ||
+      s.incons == NULL || vals == NULL || priorities == NULL)
+  {
+    fprintf(stderr, "findPathAnytime(): Out of memory.\n");
+    exit(1);
+  }
+  for (int i = 0; i < numPixels; i++)
+    s.g[i] = INFINITY;
+
+  s.g[source] = 0.0;
+  s.h[source] = heuristic(&s, source);
+  s.parent[source] = -1;
+  heapPush(s.open, source, ANYTIME_EPSILON * s.h[source]);
+
+  path[0] = -1;
+  double cost = INFINITY, suboptimality = INFINITY;
+  double epsilon = ANYTIME_EPSILON;
+  for (int pass = 1; improvePath(&s, epsilon, pass, &start, budgetMs); pass++)
+  {
+    if (s.g[target] == INFINITY)
+      break; // Unreachable
+    cost = publishPath(&s, path);
+
+    // The optimum is at least the smallest g + h of anything that could
+    // still improve, which gives a tighter bound than epsilon
+    double lower = s.g[target];
+    int n = 0;
+    for (int i = 0; i < s.open->numItems; i++)
+      vals[n++] = s.open->arr[i].val;
+    for (int i = 0; i < s.numIncons; i++)
+      vals[n++] = s.incons[i];
+    for (int i = 0; i < n; i++)
+      if (s.g[vals[i]] + s.h[vals[i]] < lower)
+        lower = s.g[vals[i]] + s.h[vals[i]];
+    // A free path is optimal; otherwise a zero lower bound says nothing
+    // better than epsilon
+    if (s.g[target] == 0.0)
+      suboptimality = 1.0;
+    else if (lower > 0.0)
+      suboptimality = s.g[target] / lower;
+    else
+      suboptimality = epsilon;
+    if (suboptimality > epsilon)
+      suboptimality = epsilon;
+    if (epsilon == 1.0 && s.numIncons == 0)
+      suboptimality = 1.0;
+
+    if (suboptimality <= 1.0 || elapsedMs(&start) > budgetMs)
+      break;
+
+    // Next pass: lower epsilon, and put everything inconsistent back
+    epsilon = 1.0 + (epsilon - 1.0) * 0.5;
+    if (epsilon < 1.01)
+      epsilon = 1.0;
+    for (int i = 0; i < n; i++)
+      priorities[i] = s.g[vals[i]] + epsilon * s.h[vals[i]];
+    heapBuild(s.open, vals, priorities, n);
+    s.numIncons = 0;
+  }
+
+  if (bound)
+    *bound = suboptimality;
+
+  free(priorities);
+  free(vals);
+  freeHeap(s.open);
+  free(s.incons);
+  free(s.closed);
+  free(s.parent);
+  free(s.h);
+  free(s.g);
+
+  return cost;
+}
@@ -0,0 +1,14 @@
+#ifndef __ANYTIME_H__
+#define __ANYTIME_H__
+
+#include "marcher.h"
+#include "landmarks.h"
+
+// Heuristic inflation for the first (fast) pass of findPathAnytime()
+#define ANYTIME_EPSILON 3.0
+
+double findPathAnytime(Image *im, WeightFunc weight, Landmarks *lm,
+                       double minStep, int source, int target,
+                       double budgetMs, int path[], double *bound);
+
+#endif // __ANYTIME_H__
@@ -0,0 +1,101 @@
+#include "chaincode.h"
+
+/**
+ * Allocate a chain code with room for `numSteps` steps on an image that is
+ * `sx` pixels wide. A path of L pixels takes L / 4 bytes this way, instead of
+ * 4 * L bytes as an array of pixel indices.
+ */
+PathChain *newChainCode(int numSteps, int sx)
+{
+  PathChain *chain = calloc(sizeof(PathChain), 1);
+  if (chain != NULL)
+  {
+    chain->numSteps = numSteps;
+    chain->sx = sx;
+    chain->codes = calloc((numSteps + 3) / 4 + 1, sizeof(uint8_t));
+    if (chain->codes != NULL)
+      return chain;
+  }
+  fprintf(stderr, "newChainCode(): Out of memory.\n");
+  exit(1);
+}
+
+/**
+ * Encode `length` pixel indices (each 4-connected to the next) from `path`.
+ */
+PathChain *chainCodeFromPath(int path[], int length, int sx)
+{
+  PathChain *chain = newChainCode(length > 0 ? length - 1 : 0, sx);
+  chain->start = length > 0 ? path[0] : -1;
+  for (int i = 0; i + 1 < length; i++)
+    chainCodeSetStep(chain, i, path[i], path[i + 1]);
+  return chain;
+}
+
+/**
+ * Record that step number `step` goes from pixel `from` to pixel `to`.
+ */
+void chainCodeSetStep(PathChain *chain, int step, int from, int to)
+{
+  int code;
+  if (to == from + 1)
+    code = CHAIN_RIGHT;
+  else if (to == from + chain->sx)
+    code = CHAIN_DOWN;
+  else if (to == from - 1)
+    code = CHAIN_LEFT;
+  else
+    code = CHAIN_UP;
+
+  int shift = (step & 3) * 2;
+  chain->codes[step >> 2] =
+      (chain->codes[step >> 2] & ~(3 << shift)) | (code << shift);
+}
+
+/**
+ * Direction (CHAIN_RIGHT, ...) of step number `step`.
+ */
+int chainCodeGetStep(PathChain *chain, int step)
+{
+  return (chain->codes[step >> 2] >> ((step & 3) * 2)) & 3;
+}
+
+/**
+ * Call `visit(pixelIndex, ctx)` for each pixel along the path, in order.
+ */
+void chainCodeWalk(PathChain *chain, PathVisitor visit, void *ctx)
+{
+  int delta[4] = {1, chain->sx, -1, -chain->sx};
+  int pixelIndex = chain->start;
+
+  if (pixelIndex < 0)
+    return;
+  visit(pixelIndex, ctx);
+  for (int i = 0; i < chain->numSteps; i++)
+  {
+    pixelIndex += delta[chainCodeGetStep(chain, i)];
+    visit(pixelIndex, ctx);
+  }
+}
+
+/**
+ * Decode the chain into `path`, which needs room for numSteps + 1 entries.
+ * No -1 terminator is added.
+ */
+void chainCodeToPath(PathChain *chain, int path[])
+{
+  int delta[4] = {1, chain->sx, -1, -chain->sx};
+
+  if (chain->start < 0)
+    return;
+  path[0] = chain->start;
+  for (int i = 0; i < chain->numSteps; i++)
+    path[i + 1] = path[i] + delta[chainCodeGetStep(chain, i)];
+}
+
+void freeChainCode(PathChain *chain)
+{
+  if (chain)
+    free(chain->codes);
+  free(chain);
+}
@@ -0,0 +1,34 @@
+#ifndef __CHAINCODE_H__
+#define __CHAINCODE_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+// Step directions of a chain code
+#define CHAIN_RIGHT 0
+#define CHAIN_DOWN 1
+#define CHAIN_LEFT 2
+#define CHAIN_UP 3
+
+// Called once for each pixel along a path
+typedef void (*PathVisitor)(int pixelIndex, void *ctx);
+
+// A 4-connected path stored as its first pixel plus 2 bits per step
+typedef struct
+{
+  int start;      // Index of the first pixel
+  int numSteps;   // Number of steps (pixels on the path - 1)
+  int sx;         // Width of the image the path is on
+  uint8_t *codes; // Step directions, 4 per byte (lowest bits first)
+} PathChain;
+
+PathChain *newChainCode(int numSteps, int sx);
+PathChain *chainCodeFromPath(int path[], int length, int sx);
+void chainCodeSetStep(PathChain *chain, int step, int from, int to);
+int chainCodeGetStep(PathChain *chain, int step);
+void chainCodeWalk(PathChain *chain, PathVisitor visit, void *ctx);
+void chainCodeToPath(PathChain *chain, int path[]);
+void freeChainCode(PathChain *chain);
+
+#endif // __CHAINCODE_H__
@@ -0,0 +1,136 @@
+#include "compact.h"
+#include "lazyheap.h"
+
+/**
+ * Low-memory version of findPath().
+ *
+ * findPath() keeps, per pixel, a 16-byte heap element, a 4-byte heap index,
+ * an 8-byte distance and a 4-byte parent for the whole search (at least 32
+ * bytes per pixel). This version keeps:
+ *
+ *    - distances as float                           4     bytes / pixel
+ *    - parents as 2-bit direction codes             0.25  bytes / pixel
+ *    - a 'settled' bit                              0.125 bytes / pixel
+ *    - heap entries (float, int) for frontier only  8     bytes / entry
+ *
+ * i.e. 4.375 bytes per pixel plus 8 bytes per frontier entry. There is no
+ * heap index array: a pixel whose distance improves is pushed again, and the
+ * stale entry is skipped when it comes out, so the heap only grows with the
+ * frontier (plus one entry per improvement still waiting in it). The heap
+ * and the 2-bit packing live in lazyheap.h, shared with turns.c.
+ *
+ * Distances are rounded to float during the search, so on images where two
+ * paths differ by less than float precision the path found may not be the
+ * one findPath() picks. The returned cost is recomputed in double along the
+ * path that was found.
+ */
+
+// Direction from a pixel to its parent, stored in 2 bits
+#define PARENT_LEFT 0
+#define PARENT_UP 1
+#define PARENT_RIGHT 2
+#define PARENT_DOWN 3
+
+DEFINE_LAZY_HEAP(CompactHeap, CompactEntry, compact, float, "findPathCompact")
+
+static inline void compactRelax(CompactHeap *heap, float *dist,
+                                uint8_t *settled, uint8_t *parents,
+                                Image *im, WeightFunc weight, int from,
+                                float priority, int to, int code)
+{
+  if (settled[to >> 3] & (1 << (to & 7)))
+    return;
+  float total = priority + (float)weight(im, from, to);
+  if (total < dist[to])
+  {
+    dist[to] = total;
+    setPackedCode(parents, to, code);
+    compactPush(heap, to, total);
+  }
+}
+
+double findPathCompact(Image *im, WeightFunc weight, int path[])
+{
+  int sx = im->sx, sy = im->sy;
+  int numPixels = sx * sy;
+  int target = numPixels - 1;
+
+  path[0] = -1;
+
+  float *dist = malloc(sizeof(float) * numPixels);
+  uint8_t *parents = calloc(1, (numPixels + 3) / 4);
+  uint8_t *settled = calloc(1, (numPixels + 7) / 8);
+  CompactHeap heap = {0, 1024, malloc(sizeof(CompactEntry) * 1024)};
+  if (dist == NULL || parents == NULL || settled == NULL || heap.arr == NULL)
+  {
+    fprintf(stderr, "findPathCompact(): Out of memory.\n");
+    exit(1);
+  }
+
+  for (int i = 0; i < numPixels; i++)
+    dist[i] = INFINITY;
+  dist[0] = 0.0f;
+  compactPush(&heap, 0, 0.0f);
+
+  int found = 0;
+  while (heap.numItems != 0)
+  {
+    CompactEntry e = compactExtractMin(&heap);
+    int p = e.val;
+    if ((settled[p >> 3] & (1 << (p & 7))) || e.priority != dist[p])
+      continue; // Stale entry
+    settled[p >> 3] |= 1 << (p & 7);
+
+    if (p == target)
+    {
+      found = 1;
+      break;
+    }
+
+    int x = p % sx;
+    int y = p / sx;
+    if (x > 0)
+      compactRelax(&heap, dist, settled, parents, im, weight, p, e.priority,
+                   p - 1, PARENT_RIGHT);
+    if (y > 0)
+      compactRelax(&heap, dist, settled, parents, im, weight, p, e.priority,
+                   p - sx, PARENT_DOWN);
+    if (x < sx - 1)
+      compactRelax(&heap, dist, settled, parents, im, weight, p, e.priority,
+                   p + 1, PARENT_LEFT);
+    if (y < sy - 1)
+      compactRelax(&heap, dist, settled, parents, im, weight, p, e.priority,
+                   p + sx, PARENT_UP);
+  }
+
+  double pathWeight = INFINITY;
+  if (found)
+  {
+    // Follow the direction codes back to (0,0) to get the length, then fill
+    // the path from its end
+    int step[4] = {-1, -sx, 1, sx};
+    int n = 0;
+    for (int p = target; p != 0; p += step[getPackedCode(parents, p)])
+      n++;
+
+    path[n + 1] = -1;
+    int p = target;
+    for (int i = n; i >= 0; i--)
+    {
+      path[i] = p;
+      if (i > 0)
+        p += step[getPackedCode(parents, p)];
+    }
+
+    pathWeight = 0.0;
+    for (int i = 0; i < n; i++)
+      pathWeight += weight(im, path[i], path[i + 1]);
+  }
+
+  free(heap.arr);
+  free(settled);
+  free(parents);
+  free(dist);
+
+  return pathWeight;
+}
@@ -0,0 +1,8 @@
+#ifndef __COMPACT_H__
+#define __COMPACT_H__
+
+#include "marcher.h"
+
+double findPathCompact(Image *im, WeightFunc weight, int path[]);
+
+#endif // __COMPACT_H__
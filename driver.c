@@ -1,4 +1,8 @@
 #include "marcher.h" // Includes ImgUtils.h
+#include "weightexpr.h"
+#include "anytime.h"
+
+#include <unistd.h>
 
 /****************************** Weight Functions *****************************/
 
@@ -28,53 +32,128 @@ double howWhite(Image *im, int a, int b)
 
 void usageAndExit()
 {
-  fprintf(stderr, "Usage: ./driver <image> mode\n");
+  fprintf(stderr, "Usage: ./driver [-t ms] <image> mode [expression]\n");
+  fprintf(stderr, "    -t ms: Stop after about `ms` milliseconds, and output the\n");
+  fprintf(stderr, "           best path found so far (see anytime.c)\n");
   fprintf(stderr, "    mode: 1 - Weight function (1) similarColour\n");
   fprintf(stderr, "          2 - Weight function (2) howWhite\n");
   fprintf(stderr, "          3 - Weight function (3) allColourWeight\n");
+  fprintf(stderr, "          4 - Weight given by `expression`, e.g.\n");
+  fprintf(stderr, "              \"sqrt((r1-r2)^2+(g1-g2)^2+(b1-b2)^2)+0.01\"\n");
+  fprintf(stderr, "              (see weightexpr.c for the syntax)\n");
+  fprintf(stderr, "          5 - <image> is a float32 cost raster or .pfm, and\n");
+  fprintf(stderr, "              each step costs the pixel it lands on\n");
   exit(1);
 }
 
 int main(int argc, char *argv[])
 {
   // Handle command line args
-  if (argc != 3)
+  double budgetMs = -1;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:")) != -1)
+  {
+    if (opt == 't' && atof(optarg) >= 0)
+      budgetMs = atof(optarg);
+    else
+      usageAndExit();
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
+
+  if (argc < 3)
     usageAndExit();
   int mode = atoi(argv[2]);
-  if (mode < 1 || mode > 3)
+  if (mode < 1 || mode > 5 || argc != (mode == 4 ? 4 : 3))
     usageAndExit();
 
-  Image *im = readPPMimage(argv[1]);
+  Image *im = mode == 5 ? readCostRaster(argv[1]) : readPPMimage(argv[1]);
   if (im == NULL)
     exit(1);
 
-  // Make space for output path
-  int *path = calloc(sizeof(int), im->sx * im->sy);
-  if (path == NULL)
-  {
-    fprintf(stderr, "Could not allocate space for path.\n");
-    exit(1);
-  }
-
-  // Call findPath with right weight function
+  // Pick the weight function, and the cheapest step it can return
+  WeightFunc weight = NULL;
+  double minStep = 0.0;
   switch (mode)
   {
   case 1:
-    findPath(im, similarColour, path);
+    weight = similarColour;
+    minStep = 0.01;
     break;
   case 2:
-    findPath(im, howWhite, path);
+    weight = howWhite;
+    minStep = 0.01;
     break;
   case 3:
-    findPath(im, allColourWeight, path);
+    weight = allColourWeight;
+    break;
+  case 4:
+  {
+    char error[256];
+    WeightExpr *expr = compileWeightExpr(argv[3], error, sizeof(error));
+    if (expr == NULL)
+    {
+      fprintf(stderr, "Invalid weight expression: %s\n", error);
+      exit(1);
+    }
+    buildWeightGrid(im, expr);
+    freeWeightExpr(expr);
+    weight = gridWeight;
+    break;
+  }
+  case 5:
+    weight = costWeight;
     break;
 
   default:
     break;
   }
 
+  if (budgetMs >= 0)
+  {
+    int *path = calloc(sizeof(int), im->sx * im->sy + 1);
+    if (path == NULL)
+    {
+      fprintf(stderr, "Could not allocate space for path.\n");
+      exit(1);
+    }
+    double bound;
+    double cost = findPathAnytime(im, weight, NULL, minStep, 0,
+                                  im->sx * im->sy - 1, budgetMs, path, &bound);
+    if (cost == INFINITY)
+    {
+      fprintf(stderr, "No path found within %g ms.\n", budgetMs);
+      exit(1);
+    }
+    fprintf(stderr, "Path cost %f, at most %.3f times the optimum.\n", cost,
+            bound);
+    outputPath(path, im);
+
+    free(path);
+    freeImage(im);
+    return 0;
+  }
+
+  // Find the path, then make exactly enough space for it
+  SearchWorkspace *ws = newWorkspace(im->sx * im->sy);
+  int source = 0, target = im->sx * im->sy - 1;
+  searchWorkspace(ws, im, weight, &source, NULL, 1, &target, 1, NULL, NULL);
+
+  int length = workspacePathLength(ws);
+  int *path = calloc(sizeof(int), length + 1);
+  if (path == NULL)
+  {
+    fprintf(stderr, "Could not allocate space for path.\n");
+    exit(1);
+  }
+  workspaceCopyPath(ws, path);
+  path[length] = -1;
+  freeWorkspace(ws);
+
   // Output the image.
   outputPath(path, im);
 
+  free(path);
+  freeImage(im);
   return 0;
 }
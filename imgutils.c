@@ -1,5 +1,11 @@
 #include "imgutils.h"
 
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 // Given (a pointer to) an image, and the pixel index, returns
 // the the corresponding pixel. Assumes that pixel index is valid. Note that
 // the return value is *not* a pointer.
@@ -98,6 +104,154 @@ Image *readPPMimage(char *filename)
   return (NULL);
 }
 
+static int hostIsLittleEndian()
+{
+  uint16_t one = 1;
+  return *(uint8_t *)&one == 1;
+}
+
+/**
+ * Read a raster of float32 costs, one per pixel, into an Image with no
+ * colours (see costWeight() in marcher.h). Two formats are understood:
+ *
+ *  - Cost raster: the 4 bytes "CRF1", then the width and the height as
+ *    little-endian int32s, 4 bytes of padding, and then the costs as
+ *    little-endian float32s, row by row from the top.
+ *  - Greyscale PFM: "Pf", the width and height, and a scale on text lines,
+ *    then the costs as float32s, little-endian if the scale is negative,
+ *    row by row from the *bottom*.
+ *
+ * The file is memory-mapped and the costs are used where they are, without
+ * conversion: PFM's bottom-up rows are handled with a negative row stride.
+ * Only if the floats are misaligned in the file or in the wrong byte order
+ * are they copied into memory instead.
+ */
+Image *readCostRaster(char *filename)
+{
+  int fd = open(filename, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0)
+  {
+    fprintf(stderr, "Unable to open file %s. Check the path.\n", filename);
+    exit(1);
+  }
+  size_t size = st.st_size;
+
+  // Headers are short, so parse them from a copy of the start of the file
+  char header[256] = {0};
+  ssize_t got = pread(fd, header, sizeof(header) - 1, 0);
+  int sx = 0, sy = 0, bottomUp = 0, littleEndian = 1;
+  size_t offset = 0;
+
+  if (got >= 16 && memcmp(header, "CRF1", 4) == 0)
+  {
+    // Sizes that don't fit in an int are left at 0, and rejected below
+    uint8_t *h = (uint8_t *)header;
+    uint32_t width = h[4] | h[5] << 8 | h[6] << 16 | (uint32_t)h[7] << 24;
+    uint32_t height = h[8] | h[9] << 8 | h[10] << 16 | (uint32_t)h[11] << 24;
+    if (width <= INT_MAX && height <= INT_MAX)
+    {
+      sx = width;
+      sy = height;
+    }
+    offset = 16;
+  }
+  else if (got >= 2 && memcmp(header, "Pf", 2) == 0)
+  {
+    // Three whitespace-separated values, then one whitespace character
+    double scale = 0.0;
+    int end = 0;
+    if (sscanf(header + 2, "%d %d %lf%n", &sx, &sy, &scale, &end) == 3)
+    {
+      offset = 2 + end + 1;
+      littleEndian = scale < 0;
+    }
+    bottomUp = 1;
+  }
+  else
+  {
+    fprintf(stderr, "%s: Wrong file format, not a cost raster or .pfm "
+                    "file.\n", filename);
+    exit(1);
+  }
+
+  size_t numPixels = (size_t)sx * sy;
+  if (offset == 0 || sx <= 0 || sy <= 0 || offset > size ||
+      (size - offset) / sizeof(float) < numPixels)
+  {
+    fprintf(stderr, "%s: Bad header, or the file is too short.\n", filename);
+    exit(1);
+  }
+
+  Image *img = (Image *)calloc(1, sizeof(Image));
+  if (img == NULL)
+  {
+    fprintf(stderr, "Unable to allocate memory for image structure\n");
+    exit(1);
+  }
+  img->filename = basename(filename);
+  img->sx = sx;
+  img->sy = sy;
+
+  const float *first; // First row in the file
+  if (offset % sizeof(float) == 0 && littleEndian == hostIsLittleEndian())
+  {
+    img->mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (img->mapping == MAP_FAILED)
+    {
+      fprintf(stderr, "%s: Unable to map the file.\n", filename);
+      exit(1);
+    }
+    img->mappingSize = size;
+    first = (const float *)((char *)img->mapping + offset);
+  }
+  else
+  {
+    img->costBuffer = malloc(sizeof(float) * numPixels);
+    if (img->costBuffer == NULL)
+    {
+      fprintf(stderr, "Out of memory allocating space for image\n");
+      exit(1);
+    }
+    if (pread(fd, img->costBuffer, sizeof(float) * numPixels, offset) !=
+        (ssize_t)(sizeof(float) * numPixels))
+    {
+      fprintf(stderr, "%s: Unable to read the costs.\n", filename);
+      exit(1);
+    }
+    if (littleEndian != hostIsLittleEndian())
+      for (size_t i = 0; i < numPixels; i++)
+      {
+        uint8_t *b = (uint8_t *)&img->costBuffer[i], t;
+        t = b[0], b[0] = b[3], b[3] = t;
+        t = b[1], b[1] = b[2], b[2] = t;
+      }
+    first = img->costBuffer;
+  }
+  close(fd);
+
+  if (bottomUp)
+  {
+    img->costs = first + (size_t)(sy - 1) * sx;
+    img->costStride = -(long)sx;
+  }
+  else
+  {
+    img->costs = first;
+    img->costStride = sx;
+  }
+  return img;
+}
+
+// Write the PPM header for an sx * sy image
+static void writeHeader(FILE *f, int sx, int sy)
+{
+  fprintf(f, "P6\n");
+  fprintf(f, "# Output from Marcher.c\n");
+  fprintf(f, "%d %d\n", sx, sy);
+  fprintf(f, "255\n");
+}
+
 // Output an image at the given filename
 void imageOutput(Image *img, char *filename)
 {
@@ -110,10 +264,7 @@ void imageOutput(Image *img, char *filename)
         fprintf(stderr, "Unable to open file %s.\n", filename);
         return;
       }
-      fprintf(f, "P6\n");
-      fprintf(f, "# Output from Marcher.c\n");
-      fprintf(f, "%d %d\n", img->sx, img->sy);
-      fprintf(f, "255\n");
+      writeHeader(f, img->sx, img->sy);
       fwrite(img->data, img->sx * img->sy, sizeof(Pixel), f);
       fclose(f);
       return;
@@ -122,9 +273,56 @@ void imageOutput(Image *img, char *filename)
   return;
 }
 
+// One pixel of the path, and when it was visited
+typedef struct
+{
+  int pixIdx;
+  int step;
+} PathPixel;
+
+static int comparePathPixels(const void *a, const void *b)
+{
+  const PathPixel *p = a, *q = b;
+  if (p->pixIdx != q->pixIdx)
+    return p->pixIdx < q->pixIdx ? -1 : 1;
+  return (p->step > q->step) - (p->step < q->step);
+}
+
+// Write `count` of the image's own pixels, starting at `start`. Images
+// without colours are drawn from their costs, scaled from [lo, hi] to grey.
+static void writePixels(FILE *f, Image *img, int start, int count, float lo,
+                        float hi)
+{
+  if (img->data != NULL)
+  {
+    fwrite(&img->data[start], sizeof(Pixel), count, f);
+    return;
+  }
+
+  Pixel grey[256];
+  double scale = hi > lo ? 255.0 / (hi - lo) : 0.0;
+  while (count > 0)
+  {
+    int n = count < 256 ? count : 256;
+    for (int i = 0; i < n; i++)
+    {
+      int x = (start + i) % img->sx, y = (start + i) / img->sx;
+      uint8_t v = (img->costs[y * img->costStride + x] - lo) * scale;
+      grey[i].R = grey[i].G = grey[i].B = v;
+    }
+    fwrite(grey, sizeof(Pixel), n, f);
+    start += n;
+    count -= n;
+  }
+}
+
 // Output the path onto the image. Colour changes from light
 // green to dark green based on when the pixel along the
 // path was visited
+//
+// The image itself is not copied: the path pixels are sorted by position,
+// and the file is written in one pass, with runs of original pixels in
+// between the path pixels.
 void outputPath(int path[], Image *img)
 {
 
@@ -135,24 +333,142 @@ void outputPath(int path[], Image *img)
     n++;
   }
 
-  Image *pathIm = newImage(img->sx, img->sy);
-  memcpy(pathIm->data, img->data, sizeof(Pixel) * img->sx * img->sy);
-
-  double l = 120.0 / n;
+  PathPixel *sorted = malloc(sizeof(PathPixel) * (n + 1));
+  if (sorted == NULL)
+  {
+    fprintf(stderr, "outputPath(): Out of memory\n");
+    return;
+  }
   for (int p = 0; p < n; p++)
   {
-    Pixel col = {0, 255 - (p * l), 0};
-    pathIm->data[path[p]] = col;
+    sorted[p].pixIdx = path[p];
+    sorted[p].step = p;
   }
+  qsort(sorted, n, sizeof(PathPixel), comparePathPixels);
+
+  // Images without colours (cost rasters) are drawn as grey levels, from
+  // black for the cheapest pixel to white for the most expensive
+  float lo = INFINITY, hi = -INFINITY;
+  if (img->data == NULL)
+    for (int y = 0; y < img->sy; y++)
+      for (int x = 0; x < img->sx; x++)
+      {
+        float c = img->costs[y * img->costStride + x];
+        lo = c < lo ? c : lo;
+        hi = c > hi ? c : hi;
+      }
 
   char outputName[1024];
-  sprintf(outputName, "Path-%s", img->filename);
-  imageOutput(pathIm, outputName);
+  sprintf(outputName, img->data ? "Path-%s" : "Path-%s.ppm", img->filename);
+  FILE *f = fopen(outputName, "wb+");
+  if (f == NULL)
+  {
+    fprintf(stderr, "Unable to open file %s.\n", outputName);
+    free(sorted);
+    return;
+  }
+  writeHeader(f, img->sx, img->sy);
+
+  double l = 120.0 / n;
+  int written = 0; // Number of pixels already in the file
+  for (int i = 0; i < n; i++)
+  {
+    // If a pixel is visited more than once, its last visit wins
+    if (i + 1 < n && sorted[i + 1].pixIdx == sorted[i].pixIdx)
+      continue;
+
+    int pixIdx = sorted[i].pixIdx;
+    Pixel col = {0, 255 - (sorted[i].step * l), 0};
+    writePixels(f, img, written, pixIdx - written, lo, hi);
+    fwrite(&col, sizeof(Pixel), 1, f);
+    written = pixIdx + 1;
+  }
+  writePixels(f, img, written, img->sx * img->sy - written, lo, hi);
+
+  fclose(f);
+  free(sorted);
+}
+
+// Size of the hash table used to find distinct colours. Must be a power of
+// two, and more than twice the largest palette allowed.
+#define PALETTE_TABLE 1024
+
+// Find the distinct colours in the image. If there are at most `maxColours`
+// (which can be up to 256) of them, store them as the image's palette along
+// with a 1-byte colour index per pixel, and return how many there are.
+// Otherwise leave the image as it is and return 0.
+int buildPalette(Image *im, int maxColours)
+{
+  int keys[PALETTE_TABLE];  // 24-bit colour + 1, 0 for empty slots
+  int slots[PALETTE_TABLE]; // Palette entry for each key
+  int n = im->sx * im->sy;
+  int numColours = 0;
+
+  if (maxColours > 256)
+    maxColours = 256;
+
+  Pixel *palette = malloc(sizeof(Pixel) * maxColours);
+  int *rep = malloc(sizeof(int) * maxColours);
+  uint8_t *colourIndex = malloc(sizeof(uint8_t) * n);
+  if (palette == NULL || rep == NULL || colourIndex == NULL)
+  {
+    fprintf(stderr, "buildPalette(): Out of memory\n");
+    exit(1);
+  }
+  memset(keys, 0, sizeof(keys));
+
+  for (int i = 0; i < n; i++)
+  {
+    Pixel p = im->data[i];
+    int key = ((p.R << 16) | (p.G << 8) | p.B) + 1;
+    int h = (key * 2654435761u) >> 22 & (PALETTE_TABLE - 1);
+    while (keys[h] != 0 && keys[h] != key)
+      h = (h + 1) & (PALETTE_TABLE - 1);
+
+    if (keys[h] == 0)
+    {
+      if (numColours == maxColours)
+      {
+        // Too many colours for a palette
+        free(colourIndex);
+        free(rep);
+        free(palette);
+        return 0;
+      }
+      keys[h] = key;
+      slots[h] = numColours;
+      palette[numColours] = p;
+      rep[numColours] = i;
+      numColours++;
+    }
+    colourIndex[i] = slots[h];
+  }
+
+  free(im->palette);
+  free(im->paletteRep);
+  free(im->colourIndex);
+  free(im->paletteWeights);
+  im->numColours = numColours;
+  im->palette = palette;
+  im->paletteRep = rep;
+  im->colourIndex = colourIndex;
+  im->paletteWeights = NULL;
+  return numColours;
 }
 
 void freeImage(Image *im)
 {
   if (im)
+  {
     free(im->data);
+    free(im->weightGrid);
+    free(im->palette);
+    free(im->paletteRep);
+    free(im->colourIndex);
+    free(im->paletteWeights);
+    if (im->mapping)
+      munmap(im->mapping, im->mappingSize);
+    free(im->costBuffer);
+  }
   free(im);
 }
@@ -25,13 +25,32 @@ typedef struct
   char *filename;
   Pixel *data; // Actual pixel data
   int sx, sy;
+
+  double *weightGrid; // Optional precomputed step costs (see gridWeight())
+
+  // Optional palette, filled in by buildPalette()
+  int numColours;       // Number of distinct colours, 0 if no palette
+  Pixel *palette;       // The distinct colours
+  int *paletteRep;      // paletteRep[c] = index of some pixel of colour c
+  uint8_t *colourIndex; // colourIndex[pixIdx] = colour of the pixel
+  double *paletteWeights; // Cached costs (see buildPaletteWeights())
+
+  // Optional per-pixel costs, filled in by readCostRaster(). Images read
+  // that way have no colours (data == NULL).
+  const float *costs; // Cost of pixel (x, y) is costs[y * costStride + x]
+  long costStride;    // Floats from one row to the next (< 0 if bottom-up)
+  void *mapping;      // The memory-mapped file `costs` points into, or NULL
+  size_t mappingSize;
+  float *costBuffer;  // Or a copy of the costs, if it could not be mapped
 } Image;
 
 Pixel getPixel(Image *im, int pixIdx);
 Image *newImage(int sx, int sy);
 Image *readPPMimage(char *filename);
+Image *readCostRaster(char *filename);
 void imageOutput(Image *im, char *filename);
 void outputPath(int path[], Image *img);
+int buildPalette(Image *im, int maxColours);
 void freeImage(Image *im);
 
 #endif // __IMGUTILS_H__
@@ -0,0 +1,289 @@
+#include "isochrone.h"
+
+/**
+ * Bounded-cost reachability ("isochrones").
+ *
+ * findReachable() runs Dijkstra from a source, but never queues a pixel
+ * whose cost would exceed the budget, so it stops by itself once the
+ * frontier has nowhere cheaper left to go. Nothing it keeps is sized by the
+ * image: pixels get a local number the first time they are reached (through
+ * a hash map from pixel index), and the costs, pixel indices and heap are
+ * indexed by that number and grown as needed. The time and memory used
+ * scale with the number of pixels reached, not with the image. Only the
+ * result's bitmask covers the whole box around them, at 1 bit per pixel.
+ */
+
+// Everything the search keeps, indexed by local number
+typedef struct
+{
+  int numLocal, maxLocal;
+  int *pixel;   // pixel[i] = image index of local pixel i
+  double *dist; // dist[i] = best known cost of local pixel i
+
+  int tableSize; // Hash map from image index to local number (power of 2)
+  int *keys;     // Image index + 1, 0 for empty slots
+  int *slots;    // Local number for each key
+} ReachState;
+
+static int hashSlot(ReachState *s, int pixel)
+{
+  unsigned int h = (unsigned int)pixel * 2654435761u;
+  int i = (h ^ (h >> 15)) & (s->tableSize - 1);
+  while (s->keys[i] != 0 && s->keys[i] != pixel + 1)
+    i = (i + 1) & (s->tableSize - 1);
+  return i;
+}
+
+static void growTable(ReachState *s)
+{
+  int oldSize = s->tableSize;
+  int *oldKeys = s->keys, *oldSlots = s->slots;
+
+  s->tableSize *= 2;
+  s->keys = calloc(sizeof(int), s->tableSize);
+  s->slots = malloc(sizeof(int) * s->tableSize);
+  if (s->keys == NULL || s->slots == NULL)
+  {
+    fprintf(stderr, "findReachable(): Out of memory.\n");
+    exit(1);
+  }
+  for (int i = 0; i < oldSize; i++)
+    if (oldKeys[i] != 0)
+    {
+      int h = hashSlot(s, oldKeys[i] - 1);
+      s->keys[h] = oldKeys[i];
+      s->slots[h] = oldSlots[i];
+    }
+  free(oldSlots);
+  free(oldKeys);
+}
+
+/**
+ * Local number of `pixel`, or -1 if it has not been reached. With `add`, a
+ * pixel that has not been reached is given the next number instead.
+ */
+static int localIndex(ReachState *s, MinHeap *heap, int pixel, int add)
+{
+  int h = hashSlot(s, pixel);
+  if (s->keys[h] != 0)
+    return s->slots[h];
+  if (!add)
+    return -1;
+
+  if (s->numLocal == s->maxLocal)
+  {
+    s->maxLocal *= 2;
+    s->pixel = realloc(s->pixel, sizeof(int) * s->maxLocal);
+    s->dist = realloc(s->dist, sizeof(double) * s->maxLocal);
+    if (s->pixel == NULL || s->dist == NULL)
+    {
+      fprintf(stderr, "findReachable(): Out of memory.\n");
+      exit(1);
+    }
+    heapResize(heap, s->maxLocal);
+  }
+
+  int i = s->numLocal++;
+  s->pixel[i] = pixel;
+  s->keys[h] = pixel + 1;
+  s->slots[h] = i;
+  if (2 * s->numLocal > s->tableSize)
+    growTable(s);
+  return i;
+}
+
+// A reached pixel's place in the box and its cost, for sorting
+typedef struct
+{
+  int boxIndex;
+  double dist;
+} ReachedPixel;
+
+static int compareReached(const void *a, const void *b)
+{
+  return ((ReachedPixel *)a)->boxIndex - ((ReachedPixel *)b)->boxIndex;
+}
+
+/**
+ * All the pixels that can be reached from `source` for a total cost of at
+ * most `budget`, as a bitmask over the smallest box that holds them (see
+ * isochrone.h). With `keepDistances`, the cost of reaching each of them is
+ * kept too, one entry per reached pixel (see isochroneDistance()). Returns
+ * NULL if even the source is out of budget.
+ */
+Isochrone *findReachable(Image *im, WeightFunc weight, int source,
+                         double budget, int keepDistances)
+{
+  if (!(budget >= 0.0))
+    return NULL;
+
+  int sx = im->sx, sy = im->sy;
+  ReachState s = {0, 64};
+  s.pixel = malloc(sizeof(int) * s.maxLocal);
+  s.dist = malloc(sizeof(double) * s.maxLocal);
+  s.tableSize = 256;
+  s.keys = calloc(sizeof(int), s.tableSize);
+  s.slots = malloc(sizeof(int) * s.tableSize);
+  MinHeap *heap = newMinHeap(s.maxLocal);
+  if (s.pixel == NULL || s.dist == NULL || s.keys == NULL ||
+      s.slots == NULL || heap == NULL)
+  {
+    fprintf(stderr, "findReachable(): Out of memory.\n");
+    exit(1);
+  }
+
+  int first = localIndex(&s, heap, source, 1);
+  s.dist[first] = 0.0;
+  heapPush(heap, first, 0.0);
+
+  double priority;
+  while (heap->numItems != 0)
+  {
+    int i = heapExtractMin(heap, &priority);
+    int p = s.pixel[i];
+    int x = p % sx, y = p / sx;
+    int neighbours[4], count = 0;
+    if (x > 0)
+      neighbours[count++] = p - 1;
+    if (y > 0)
+      neighbours[count++] = p - sx;
+    if (x < sx - 1)
+      neighbours[count++] = p + 1;
+    if (y < sy - 1)
+      neighbours[count++] = p + sx;
+
+    for (int k = 0; k < count; k++)
+    {
+      double total = priority + weight(im, p, neighbours[k]);
+      if (!(total <= budget))
+        continue; // Out of budget (or unreachable), never queued
+
+      int before = s.numLocal;
+      int j = localIndex(&s, heap, neighbours[k], 1);
+      if (s.numLocal != before)
+      {
+        s.dist[j] = total;
+        heapPush(heap, j, total);
+      }
+      else if (heap->indices[j] != -1 && total < s.dist[j])
+      {
+        s.dist[j] = total;
+        heapDecreasePriority(heap, j, total);
+      }
+    }
+  }
+
+  // Everything that was queued is within budget, and has been settled
+  int x0 = sx, y0 = sy, x1 = -1, y1 = -1;
+  for (int i = 0; i < s.numLocal; i++)
+  {
+    int x = s.pixel[i] % sx, y = s.pixel[i] / sx;
+    x0 = x < x0 ? x : x0;
+    y0 = y < y0 ? y : y0;
+    x1 = x > x1 ? x : x1;
+    y1 = y > y1 ? y : y1;
+  }
+
+  Isochrone *iso = calloc(sizeof(Isochrone), 1);
+  if (iso == NULL)
+  {
+    fprintf(stderr, "findReachable(): Out of memory.\n");
+    exit(1);
+  }
+  iso->x0 = x0;
+  iso->y0 = y0;
+  iso->sx = x1 - x0 + 1;
+  iso->sy = y1 - y0 + 1;
+  iso->numReached = s.numLocal;
+  size_t boxSize = (size_t)iso->sx * iso->sy;
+  iso->mask = calloc(1, (boxSize + 7) / 8);
+  if (iso->mask == NULL)
+  {
+    fprintf(stderr, "findReachable(): Out of memory.\n");
+    exit(1);
+  }
+  for (int i = 0; i < s.numLocal; i++)
+  {
+    int b = (s.pixel[i] % sx - x0) + (s.pixel[i] / sx - y0) * iso->sx;
+    iso->mask[b >> 3] |= 1 << (b & 7);
+  }
+
+  if (keepDistances)
+  {
+    ReachedPixel *reached = malloc(sizeof(ReachedPixel) * s.numLocal);
+    iso->boxIndex = malloc(sizeof(int) * s.numLocal);
+    iso->dist = malloc(sizeof(double) * s.numLocal);
+    if (reached == NULL || iso->boxIndex == NULL || iso->dist == NULL)
+    {
+      fprintf(stderr, "findReachable(): Out of memory.\n");
+      exit(1);
+    }
+    for (int i = 0; i < s.numLocal; i++)
+    {
+      reached[i].boxIndex =
+          (s.pixel[i] % sx - x0) + (s.pixel[i] / sx - y0) * iso->sx;
+      reached[i].dist = s.dist[i];
+    }
+    qsort(reached, s.numLocal, sizeof(ReachedPixel), compareReached);
+    for (int i = 0; i < s.numLocal; i++)
+    {
+      iso->boxIndex[i] = reached[i].boxIndex;
+      iso->dist[i] = reached[i].dist;
+    }
+    free(reached);
+  }
+
+  freeHeap(heap);
+  free(s.slots);
+  free(s.keys);
+  free(s.dist);
+  free(s.pixel);
+
+  return iso;
+}
+
+/**
+ * Is pixel (x, y) of the image in the reachable set?
+ */
+int isochroneReached(Isochrone *iso, int x, int y)
+{
+  x -= iso->x0;
+  y -= iso->y0;
+  if (x < 0 || y < 0 || x >= iso->sx || y >= iso->sy)
+    return 0;
+  int b = x + y * iso->sx;
+  return (iso->mask[b >> 3] >> (b & 7)) & 1;
+}
+
+/**
+ * Cost of reaching pixel (x, y) of the image, or INFINITY if it is not in
+ * the reachable set. Only for isochrones found with `keepDistances`.
+ * O(log numReached).
+ */
+double isochroneDistance(Isochrone *iso, int x, int y)
+{
+  if (!isochroneReached(iso, x, y))
+    return INFINITY;
+  int b = (x - iso->x0) + (y - iso->y0) * iso->sx;
+  int lo = 0, hi = iso->numReached - 1;
+  while (lo < hi)
+  {
+    int mid = lo + (hi - lo) / 2;
+    if (iso->boxIndex[mid] < b)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return iso->dist[lo];
+}
+
+void freeIsochrone(Isochrone *iso)
+{
+  if (iso)
+  {
+    free(iso->mask);
+    free(iso->boxIndex);
+    free(iso->dist);
+  }
+  free(iso);
+}
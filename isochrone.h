@@ -0,0 +1,27 @@
+#ifndef __ISOCHRONE_H__
+#define __ISOCHRONE_H__
+
+#include "marcher.h"
+
+// Pixels reachable within a cost budget, see findReachable(). The mask
+// takes 1 bit per pixel of the box around the reached pixels, which for a
+// thin set (a maze corridor, a diagonal band) can be most of the image;
+// everything else is sized by the number of pixels reached.
+typedef struct
+{
+  int x0, y0;     // Top-left corner of the box around the reached pixels
+  int sx, sy;     // Size of the box
+  int numReached; // Number of pixels reached
+  uint8_t *mask;  // Bit (x - x0) + (y - y0) * sx is set if (x, y) is reached
+  int *boxIndex;  // Optional: (x - x0) + (y - y0) * sx of each reached pixel,
+                  // in increasing order (NULL unless asked for)
+  double *dist;   // Optional: dist[i] = cost of reaching pixel boxIndex[i]
+} Isochrone;
+
+Isochrone *findReachable(Image *im, WeightFunc weight, int source,
+                         double budget, int keepDistances);
+int isochroneReached(Isochrone *iso, int x, int y);
+double isochroneDistance(Isochrone *iso, int x, int y);
+void freeIsochrone(Isochrone *iso);
+
+#endif // __ISOCHRONE_H__
@@ -0,0 +1,304 @@
+#include "landmarks.h"
+
+#include <pthread.h>
+
+/**
+ * Landmark (ALT) goal-directed search.
+ *
+ * For images that are queried many times, a few landmark pixels L are
+ * picked once, and the exact costs d(L, v) from each landmark to every
+ * pixel and d(v, L) from every pixel to each landmark are stored. By the
+ * triangle inequality, for any pixels v and t:
+ *
+ *      d(v, t) >= d(L, t) - d(L, v)
+ *      d(v, t) >= d(v, L) - d(t, L)
+ *
+ * so the largest of these over all landmarks is a lower bound on the cost
+ * still to go, which A* uses to search towards the target instead of in all
+ * directions. This holds for any non-negative WeightFunc, including
+ * asymmetric ones, so the answers stay exact.
+ *
+ * Memory is 2 floats per pixel per landmark. Rounding the distances to float
+ * could make the bound slightly too large, so each bound is lowered by a few
+ * float ulps of the values involved, and nodes are re-opened if a cheaper
+ * way to them is found later, which keeps the search exact either way.
+ */
+
+// What one thread needs to compute distance fields
+typedef struct
+{
+  Image *im;
+  WeightFunc weight;
+  Landmarks *lm;
+  int next; // Next field nobody has claimed yet (updated atomically)
+} FieldJob;
+
+/**
+ * Dijkstra from (or, if `reverse`, to) a single pixel over the whole image,
+ * in the workspace `ws`. Afterwards ws->dist holds the cost of every pixel
+ * whose stamp is current (the others cannot be reached).
+ */
+static void distanceField(SearchWorkspace *ws, Image *im, WeightFunc weight,
+                          int pixel, int reverse)
+{
+  int sx = im->sx, sy = im->sy;
+
+  workspaceBegin(ws, sx * sy);
+  ws->stamp[pixel] = ws->epoch;
+  ws->dist[pixel] = 0.0;
+  heapPush(&ws->heap, pixel, 0.0);
+
+  double priority;
+  while (ws->heap.numItems != 0)
+  {
+    int p = heapExtractMin(&ws->heap, &priority);
+    int x = p % sx, y = p / sx;
+    int neighbours[4], count = 0;
+    if (x > 0)
+      neighbours[count++] = p - 1;
+    if (y > 0)
+      neighbours[count++] = p - sx;
+    if (x < sx - 1)
+      neighbours[count++] = p + 1;
+    if (y < sy - 1)
+      neighbours[count++] = p + sx;
+
+    for (int i = 0; i < count; i++)
+    {
+      int q = neighbours[i];
+      double w = reverse ? weight(im, q, p) : weight(im, p, q);
+      double total = priority + w;
+      if (ws->stamp[q] != ws->epoch)
+      {
+        if (total < INFINITY)
+        {
+          ws->stamp[q] = ws->epoch;
+          ws->dist[q] = total;
+          heapPush(&ws->heap, q, total);
+        }
+      }
+      else if (ws->heap.indices[q] != -1 && total < ws->dist[q])
+      {
+        ws->dist[q] = total;
+        heapDecreasePriority(&ws->heap, q, total);
+      }
+    }
+  }
+}
+
+static void *fieldWorker(void *arg)
+{
+  FieldJob *job = (FieldJob *)arg;
+  Landmarks *lm = job->lm;
+  int k = lm->numLandmarks;
+  SearchWorkspace *ws = newWorkspace(lm->numPixels);
+
+  while (1)
+  {
+    // Fields 0..k-1 are forward, k..2k-1 backward
+    int f = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+    if (f >= 2 * k)
+      break;
+
+    int l = f % k;
+    float *out = f < k ? lm->forward : lm->backward;
+    distanceField(ws, job->im, job->weight, lm->pixels[l], f >= k);
+    for (int v = 0; v < lm->numPixels; v++)
+      out[v * k + l] = ws->stamp[v] == ws->epoch ? (float)ws->dist[v]
+                                                 : INFINITY;
+  }
+
+  freeWorkspace(ws);
+  return NULL;
+}
+
+/**
+ * Pick `numLandmarks` landmarks and compute their distance fields (two full
+ * searches per landmark), spread across `numThreads` threads.
+ *
+ * Landmarks are spaced evenly around the border of the image, starting at
+ * (0, 0): landmarks "behind" the source or target give the best bounds,
+ * and on a grid the border is behind everything.
+ */
+Landmarks *buildLandmarks(Image *im, WeightFunc weight, int numLandmarks,
+                          int numThreads)
+{
+  int sx = im->sx, sy = im->sy;
+  int perimeter = sx > 1 && sy > 1 ? 2 * (sx + sy) - 4 : sx * sy;
+
+  Landmarks *lm = calloc(sizeof(Landmarks), 1);
+  if (lm == NULL)
+  {
+    fprintf(stderr, "buildLandmarks(): Out of memory.\n");
+    exit(1);
+  }
+  if (numLandmarks > perimeter)
+    numLandmarks = perimeter;
+  lm->numLandmarks = numLandmarks;
+  lm->numPixels = sx * sy;
+  lm->pixels = malloc(sizeof(int) * numLandmarks);
+  lm->forward = malloc(sizeof(float) * numLandmarks * lm->numPixels);
+  lm->backward = malloc(sizeof(float) * numLandmarks * lm->numPixels);
+  if (lm->pixels == NULL || lm->forward == NULL || lm->backward == NULL)
+  {
+    fprintf(stderr, "buildLandmarks(): Out of memory.\n");
+    exit(1);
+  }
+
+  for (int l = 0; l < numLandmarks; l++)
+  {
+    // Walk clockwise around the border: top, right, bottom, left
+    int d = (int)((long)l * perimeter / numLandmarks);
+    int x, y;
+    if (sx == 1 || sy == 1)
+      x = d % sx, y = d / sx;
+    else if (d < sx - 1)
+      x = d, y = 0;
+    else if ((d -= sx - 1) < sy - 1)
+      x = sx - 1, y = d;
+    else if ((d -= sy - 1) < sx - 1)
+      x = sx - 1 - d, y = sy - 1;
+    else
+      x = 0, y = sy - 1 - (d - (sx - 1));
+    lm->pixels[l] = x + y * sx;
+  }
+
+  FieldJob job = {im, weight, lm, 0};
+  if (numThreads > 2 * numLandmarks)
+    numThreads = 2 * numLandmarks;
+  if (numThreads <= 1)
+  {
+    fieldWorker(&job);
+    return lm;
+  }
+
+  pthread_t threads[numThreads];
+  for (int t = 0; t < numThreads; t++)
+    if (pthread_create(&threads[t], NULL, fieldWorker, &job) != 0)
+    {
+      fprintf(stderr, "buildLandmarks(): Unable to create thread.\n");
+      exit(1);
+    }
+  for (int t = 0; t < numThreads; t++)
+    pthread_join(threads[t], NULL);
+  return lm;
+}
+
+void freeLandmarks(Landmarks *lm)
+{
+  if (lm)
+  {
+    free(lm->pixels);
+    free(lm->forward);
+    free(lm->backward);
+  }
+  free(lm);
+}
+
+/**
+ * Lower bound on the cost from pixel `v` to pixel `target`.
+ */
+double landmarkHeuristic(Landmarks *lm, int v, int target)
+{
+  int k = lm->numLandmarks;
+  const float *fv = &lm->forward[v * k], *ft = &lm->forward[target * k];
+  const float *bv = &lm->backward[v * k], *bt = &lm->backward[target * k];
+  double best = 0.0;
+
+  for (int l = 0; l < k; l++)
+  {
+    // Each float is within 2^-24 (relative) of the exact distance, so
+    // lowering each difference by 2^-22 of its terms keeps it a bound
+    double a = ft[l], b = fv[l];
+    if (a < INFINITY && b < INFINITY)
+    {
+      double bound = (a - b) - (a + b) * 0x1p-22;
+      if (bound > best)
+        best = bound;
+    }
+    a = bv[l], b = bt[l];
+    if (a < INFINITY && b < INFINITY)
+    {
+      double bound = (a - b) - (a + b) * 0x1p-22;
+      if (bound > best)
+        best = bound;
+    }
+  }
+  return best;
+}
+
+/**
+ * Least-energy path from `source` to `target` using A* with the landmark
+ * bounds, with its state in `ws` (see newWorkspace()), so repeated queries
+ * only pay for the pixels they touch. The path is written like findPath()
+ * (ending with -1) and also stays in the workspace for workspaceCopyPath()
+ * and friends. The cost is returned (INFINITY if the target cannot be
+ * reached).
+ */
+double findPathLandmarks(SearchWorkspace *ws, Image *im, WeightFunc weight,
+                         Landmarks *lm, int source, int target, int path[])
+{
+  int sx = im->sx, sy = im->sy;
+
+  workspaceBegin(ws, sx * sy);
+  ws->sx = sx;
+  ws->endPixel = -1;
+  ws->pathLength = 0;
+
+  ws->stamp[source] = ws->epoch;
+  ws->dist[source] = 0.0;
+  ws->parent[source] = -1;
+  heapPush(&ws->heap, source, landmarkHeuristic(lm, source, target));
+
+  double priority;
+  while (ws->heap.numItems != 0)
+  {
+    int p = heapExtractMin(&ws->heap, &priority);
+    if (p == target)
+    {
+      ws->endPixel = p;
+      break;
+    }
+
+    int x = p % sx, y = p / sx;
+    int neighbours[4], count = 0;
+    if (x > 0)
+      neighbours[count++] = p - 1;
+    if (y > 0)
+      neighbours[count++] = p - sx;
+    if (x < sx - 1)
+      neighbours[count++] = p + 1;
+    if (y < sy - 1)
+      neighbours[count++] = p + sx;
+
+    for (int i = 0; i < count; i++)
+    {
+      int q = neighbours[i];
+      double total = ws->dist[p] + weight(im, p, q);
+      int seen = ws->stamp[q] == ws->epoch;
+      if (!(total < (seen ? ws->dist[q] : INFINITY)))
+        continue;
+
+      ws->stamp[q] = ws->epoch;
+      ws->dist[q] = total;
+      ws->parent[q] = p;
+      double f = total + landmarkHeuristic(lm, q, target);
+      if (seen && ws->heap.indices[q] != -1)
+        heapDecreasePriority(&ws->heap, q, f);
+      else
+        heapPush(&ws->heap, q, f); // New, or re-opened
+    }
+  }
+
+  path[0] = -1;
+  if (ws->endPixel == -1)
+    return INFINITY;
+
+  int n = 0;
+  for (int p = target; p != -1; p = ws->parent[p])
+    n++;
+  ws->pathLength = n;
+  workspaceCopyPath(ws, path);
+  path[n] = -1;
+  return ws->dist[target];
+}
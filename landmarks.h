@@ -0,0 +1,23 @@
+#ifndef __LANDMARKS_H__
+#define __LANDMARKS_H__
+
+#include "marcher.h"
+
+// Distances to and from a few landmark pixels, see buildLandmarks()
+typedef struct
+{
+  int numLandmarks;
+  int *pixels;     // The landmark pixels
+  int numPixels;   // Size of the image they were computed for
+  float *forward;  // forward[v * numLandmarks + l]  = cost landmark l -> v
+  float *backward; // backward[v * numLandmarks + l] = cost v -> landmark l
+} Landmarks;
+
+Landmarks *buildLandmarks(Image *im, WeightFunc weight, int numLandmarks,
+                          int numThreads);
+double landmarkHeuristic(Landmarks *lm, int v, int target);
+double findPathLandmarks(SearchWorkspace *ws, Image *im, WeightFunc weight,
+                         Landmarks *lm, int source, int target, int path[]);
+void freeLandmarks(Landmarks *lm);
+
+#endif // __LANDMARKS_H__
@@ -0,0 +1,93 @@
+#ifndef __LAZYHEAP_H__
+#define __LAZYHEAP_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Internal helpers shared by the low-memory searches (compact.c, turns.c).
+ *
+ * DEFINE_LAZY_HEAP(Heap, Entry, prefix, Priority, caller) defines a binary
+ * min-heap of (Priority, int) entries with no index array, as the types
+ * `Heap` and `Entry` and the static functions prefix##Push() and
+ * prefix##ExtractMin(). An item whose priority improves is pushed again,
+ * and the caller skips stale entries as they come out, so the heap only
+ * grows with the frontier. `Heap` starts as {0, capacity, array} and
+ * doubles when full; `caller` names the function to blame when that runs
+ * out of memory.
+ */
+#define DEFINE_LAZY_HEAP(Heap, Entry, prefix, Priority, caller)              \
+  typedef struct                                                             \
+  {                                                                          \
+    Priority priority;                                                       \
+    int val;                                                                 \
+  } Entry;                                                                   \
+                                                                             \
+  typedef struct                                                             \
+  {                                                                          \
+    int numItems;                                                            \
+    int maxSize;                                                             \
+    Entry *arr;                                                              \
+  } Heap;                                                                    \
+                                                                             \
+  static void prefix##Push(Heap *heap, int val, Priority priority)           \
+  {                                                                          \
+    if (heap->numItems == heap->maxSize)                                     \
+    {                                                                        \
+      heap->maxSize *= 2;                                                    \
+      heap->arr = realloc(heap->arr, sizeof(Entry) * heap->maxSize);         \
+      if (heap->arr == NULL)                                                 \
+      {                                                                      \
+        fprintf(stderr, caller "(): Out of memory.\n");                      \
+        exit(1);                                                             \
+      }                                                                      \
+    }                                                                        \
+                                                                             \
+    int i = heap->numItems++;                                                \
+    while (i > 0 && priority < heap->arr[(i - 1) / 2].priority)              \
+    {                                                                        \
+      heap->arr[i] = heap->arr[(i - 1) / 2];                                 \
+      i = (i - 1) / 2;                                                       \
+    }                                                                        \
+    heap->arr[i].priority = priority;                                        \
+    heap->arr[i].val = val;                                                  \
+  }                                                                          \
+                                                                             \
+  static Entry prefix##ExtractMin(Heap *heap)                                \
+  {                                                                          \
+    Entry top = heap->arr[0];                                                \
+    Entry last = heap->arr[--heap->numItems];                                \
+                                                                             \
+    int i = 0;                                                               \
+    while (1)                                                                \
+    {                                                                        \
+      int child = 2 * i + 1;                                                 \
+      if (child >= heap->numItems)                                           \
+        break;                                                               \
+      if (child + 1 < heap->numItems &&                                      \
+          heap->arr[child + 1].priority < heap->arr[child].priority)         \
+        child++;                                                             \
+      if (!(heap->arr[child].priority < last.priority))                      \
+        break;                                                               \
+      heap->arr[i] = heap->arr[child];                                       \
+      i = child;                                                             \
+    }                                                                        \
+    heap->arr[i] = last;                                                     \
+    return top;                                                              \
+  }
+
+// 2-bit codes packed 4 to a byte: code `i` is in bits (i & 3) * 2 of
+// codes[i >> 2]
+static inline int getPackedCode(uint8_t *codes, int i)
+{
+  return (codes[i >> 2] >> ((i & 3) * 2)) & 3;
+}
+
+static inline void setPackedCode(uint8_t *codes, int i, int code)
+{
+  int shift = (i & 3) * 2;
+  codes[i >> 2] = (codes[i >> 2] & ~(3 << shift)) | (code << shift);
+}
+
+#endif // __LAZYHEAP_H__
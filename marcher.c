@@ -56,122 +56,523 @@
  */
 double findPath(Image *mp, WeightFunc weight, int path[])
 {
+  int source = 0;
+  int target = (mp->sx * mp->sy) - 1;
 
-  path[0] = -1; // Terminate path
+  return findPathMulti(mp, weight, &source, NULL, 1, &target, 1, path,
+                       NULL, NULL);
+}
+
+/**
+ * Allocate a workspace that can hold the search state for images of up to
+ * `maxPixels` pixels. All of the per-pixel arrays live in a single block.
+ *
+ * A workspace can be reused for any number of searches (it grows if a larger
+ * image comes along). Instead of clearing the arrays between searches, every
+ * search gets a new `epoch`, and a pixel's entries only count as valid if its
+ * stamp matches the current epoch. Starting a new search is therefore O(1),
+ * and the cost of a search is proportional to the pixels it touches rather
+ * than to the size of the image.
+ *
+ * Reentrancy: the *Workspace() functions keep all of their mutable state in
+ * the workspace, and only ever read from the image (including the optional
+ * weightGrid / palette tables, which must be built beforehand). So any
+ * number of threads can search the same image at the same time, as long as
+ * each uses its own workspace and the weight function is itself read-only
+ * (which all of the weight functions here are). See runQueries().
+ */
+SearchWorkspace *newWorkspace(int maxPixels)
+{
+  SearchWorkspace *ws = calloc(sizeof(SearchWorkspace), 1);
+  if (ws == NULL)
+  {
+    fprintf(stderr, "newWorkspace(): Out of memory.\n");
+    exit(1);
+  }
+  workspaceReserve(ws, maxPixels);
+  return ws;
+}
+
+/**
+ * Make sure the workspace can hold `numPixels` pixels, reallocating its
+ * arena (and forgetting any previous search) if it can't.
+ */
+void workspaceReserve(SearchWorkspace *ws, int numPixels)
+{
+  if (ws->arena != NULL && numPixels <= ws->maxPixels)
+    return;
+
+  // Wider elements first so that everything stays aligned. The arena comes
+  // from calloc() so the stamps start at 0; for large arenas that is done
+  // lazily by the OS, and only the pages a search touches get faulted in.
+  size_t n = numPixels > 0 ? numPixels : 1;
+  free(ws->arena);
+  ws->arena = calloc(n, sizeof(HeapElement) + sizeof(double) +
+                            5 * sizeof(int));
+  if (ws->arena == NULL)
+  {
+    fprintf(stderr, "workspaceReserve(): Out of memory.\n");
+    exit(1);
+  }
+
+  ws->maxPixels = numPixels;
+  ws->heap.arr = (HeapElement *)ws->arena;
+  ws->dist = (double *)(ws->heap.arr + n);
+  ws->heap.indices = (int *)(ws->dist + n);
+  ws->parent = ws->heap.indices + n;
+  ws->targetSlot = ws->parent + n;
+  ws->stamp = (unsigned int *)(ws->targetSlot + n);
+  ws->targetStamp = ws->stamp + n;
+  ws->heap.maxSize = numPixels;
+  ws->heap.numItems = 0;
+
+  ws->epoch = 0;
+}
+
+/**
+ * Start a new search in the workspace, invalidating all per-pixel state from
+ * the previous one without touching it. Searches outside this file use it
+ * too: a pixel's dist/parent are only valid if stamp[p] == epoch, and it is
+ * in the heap only if it is valid and heap.indices[p] != -1.
+ */
+void workspaceBegin(SearchWorkspace *ws, int numPixels)
+{
+  workspaceReserve(ws, numPixels);
+  ws->heap.numItems = 0;
+  ws->epoch++;
+  if (ws->epoch == 0)
+  {
+    // The stamps wrapped around, so old ones could look current again
+    memset(ws->stamp, 0, 2 * (size_t)ws->maxPixels * sizeof(unsigned int));
+    ws->epoch = 1;
+  }
+}
 
-  MinHeap *minHeap = newMinHeap(mp->sx + (mp->sy * mp->sx));
-  int pixelIndex;
+void freeWorkspace(SearchWorkspace *ws)
+{
+  if (ws)
+    free(ws->arena);
+  free(ws);
+}
+
+/**
+ * Relax the edge from `pixelIndex` (already settled at cost `priority`) to
+ * its neighbour `value`. Neighbours that have never been reached are pushed
+ * onto the heap here, so the heap only ever holds the current frontier.
+ */
+static void relax(SearchWorkspace *ws, Image *mp, WeightFunc weight,
+                  int pixelIndex, double priority, int value)
+{
+  double totalPriority = priority + weight(mp, pixelIndex, value);
 
-  for (int i = 0; i < (mp->sx + (mp->sy * mp->sx)); i++)
+  if (ws->stamp[value] != ws->epoch)
   {
-    if ((i % mp->sx) == 0 && (i / mp->sx) == 0)
+    if (totalPriority < INFINITY)
     {
-      heapPush(minHeap, i, 0.0);
+      ws->stamp[value] = ws->epoch;
+      ws->dist[value] = totalPriority;
+      ws->parent[value] = pixelIndex;
+      heapPush(&ws->heap, value, totalPriority);
     }
-    else
+  }
+  else if (ws->heap.indices[value] != -1 && totalPriority < ws->dist[value])
+  {
+    ws->dist[value] = totalPriority;
+    ws->parent[value] = pixelIndex;
+    heapDecreasePriority(&ws->heap, value, totalPriority);
+  }
+}
+
+/**
+ * Multi-source / multi-target version of findPath().
+ *
+ * Input:
+ *  - sources, numSources: Pixel indices the path may start from.
+ *  - sourceCosts: Initial cost of starting at each source, or NULL if every
+ *                 source starts at 0.0. Must be non-negative.
+ *  - targets, numTargets: Pixel indices the path may end at.
+ *
+ * A single search is run with the frontier seeded by all of the sources, and
+ * it stops as soon as the first target is settled, so this gives the same
+ * answer as calling findPath() once per (source, target) pair and keeping the
+ * cheapest - at the price of a single search.
+ *
+ * The path is written to `path` exactly like findPath(), starting at the
+ * winning source and ending at the winning target. If `sourceIdx` or
+ * `targetIdx` are not NULL, the positions of the winning pair within
+ * `sources` / `targets` are stored there.
+ *
+ * Returns the cost of the path (including the initial cost of its source),
+ * or INFINITY if no target can be reached. In that case path[0] = -1 and the
+ * winning indices are set to -1.
+ */
+double findPathMulti(Image *mp, WeightFunc weight, int sources[],
+                     double sourceCosts[], int numSources, int targets[],
+                     int numTargets, int path[], int *sourceIdx,
+                     int *targetIdx)
+{
+  SearchWorkspace *ws = newWorkspace(mp->sx * mp->sy);
+  double pathWeight = findPathMultiWorkspace(ws, mp, weight, sources,
+                                             sourceCosts, numSources, targets,
+                                             numTargets, path, sourceIdx,
+                                             targetIdx);
+  freeWorkspace(ws);
+  return pathWeight;
+}
+
+/**
+ * findPath(), using (and reusing) the given workspace for its state.
+ */
+double findPathWorkspace(SearchWorkspace *ws, Image *mp, WeightFunc weight,
+                         int path[])
+{
+  int source = 0;
+  int target = (mp->sx * mp->sy) - 1;
+
+  return findPathMultiWorkspace(ws, mp, weight, &source, NULL, 1, &target, 1,
+                                path, NULL, NULL);
+}
+
+/**
+ * findPathMulti(), using (and reusing) the given workspace for its state.
+ */
+double findPathMultiWorkspace(SearchWorkspace *ws, Image *mp,
+                              WeightFunc weight, int sources[],
+                              double sourceCosts[], int numSources,
+                              int targets[], int numTargets, int path[],
+                              int *sourceIdx, int *targetIdx)
+{
+  double pathWeight = searchWorkspace(ws, mp, weight, sources, sourceCosts,
+                                      numSources, targets, numTargets,
+                                      sourceIdx, targetIdx);
+  workspaceCopyPath(ws, path);
+  path[ws->pathLength] = -1; // Terminate path
+  return pathWeight;
+}
+
+/**
+ * The search behind findPathMultiWorkspace(), without writing out the path.
+ *
+ * Afterwards the path stays in the workspace (until the next search), and
+ * can be read out in whichever form suits the caller:
+ *
+ *    - workspacePathLength(): number of pixels on the path (0 if no target
+ *                             was reached), known before anything is copied
+ *    - workspaceCopyPath():   fill an exactly-sized array of pixel indices
+ *    - workspaceWalkPath():   call a function for each pixel, in order
+ *    - workspaceChainCode():  2 bits per step (see chaincode.h)
+ *
+ * so callers never need an (sx * sy) sized path buffer.
+ */
+double searchWorkspace(SearchWorkspace *ws, Image *mp, WeightFunc weight,
+                       int sources[], double sourceCosts[], int numSources,
+                       int targets[], int numTargets, int *sourceIdx,
+                       int *targetIdx)
+{
+  if (sourceIdx != NULL)
+    *sourceIdx = -1;
+  if (targetIdx != NULL)
+    *targetIdx = -1;
+
+  workspaceBegin(ws, mp->sx * mp->sy);
+  ws->sx = mp->sx;
+  ws->endPixel = -1;
+  ws->pathLength = 0;
+
+  for (int i = numTargets - 1; i >= 0; i--)
+  {
+    ws->targetStamp[targets[i]] = ws->epoch;
+    ws->targetSlot[targets[i]] = i;
+  }
+
+  // Seed the frontier, keeping the cheapest cost for repeated sources, and
+  // build the heap from all of them at once (one spare slot, so that no
+  // sources is not mistaken for running out of memory)
+  int *seeds = malloc(sizeof(int) * (numSources + 1));
+  double *seedCosts = malloc(sizeof(double) * (numSources + 1));
+  if (seeds == NULL || seedCosts == NULL)
+  {
+    fprintf(stderr, "findPathMultiWorkspace(): Out of memory.\n");
+    exit(1);
+  }
+
+  int numSeeds = 0;
+  for (int i = 0; i < numSources; i++)
+  {
+    int pixelIndex = sources[i];
+    double cost = sourceCosts == NULL ? 0.0 : sourceCosts[i];
+    if (cost == INFINITY)
+    {
+      continue;
+    }
+    else if (ws->stamp[pixelIndex] != ws->epoch)
     {
-      heapPush(minHeap, i, INFINITY);
+      ws->stamp[pixelIndex] = ws->epoch;
+      seeds[numSeeds++] = pixelIndex;
     }
+    else if (cost >= ws->dist[pixelIndex])
+    {
+      continue;
+    }
+    ws->dist[pixelIndex] = cost;
+    ws->parent[pixelIndex] = -1;
   }
 
-  int parentArray[mp->sx + (mp->sy * mp->sx)];
+  for (int i = 0; i < numSeeds; i++)
+    seedCosts[i] = ws->dist[seeds[i]];
+  heapBuild(&ws->heap, seeds, seedCosts, numSeeds);
+  free(seedCosts);
+  free(seeds);
+
   double priority;
-  int endPixelIndex;
+  double pathWeight = INFINITY;
+  int endPixelIndex = -1;
 
-  double pathWeight;
-  while (minHeap->numItems != 0)
+  while (ws->heap.numItems != 0)
   {
-    pixelIndex = heapExtractMin(minHeap, &priority);
-
-    int sx = pixelIndex % mp->sx;
-    int sy = pixelIndex / mp->sx;
+    int pixelIndex = heapExtractMin(&ws->heap, &priority);
 
-    if (sx == mp->sx - 1 && sy == mp->sy - 1)
+    if (ws->targetStamp[pixelIndex] == ws->epoch)
     {
       pathWeight = priority;
       endPixelIndex = pixelIndex;
       break;
     }
-    int value;
-    double totalPriority;
-    if (sx > 0)
-    {
-      value = (sx - 1) + sy * mp->sx;
-      totalPriority = priority + weight(mp, pixelIndex, value);
-      if (minHeap->indices[value] != -1)
-      {
-        if (totalPriority < minHeap->arr[minHeap->indices[value]].priority)
-        {
-          heapDecreasePriority(minHeap, value, totalPriority);
-          parentArray[value] = pixelIndex;
-        }
-      }
-    }
 
+    int sx = pixelIndex % mp->sx;
+    int sy = pixelIndex / mp->sx;
+
+    if (sx > 0)
+      relax(ws, mp, weight, pixelIndex, priority, pixelIndex - 1);
     if (sy > 0)
+      relax(ws, mp, weight, pixelIndex, priority, pixelIndex - mp->sx);
+    if (sx < mp->sx - 1)
+      relax(ws, mp, weight, pixelIndex, priority, pixelIndex + 1);
+    if (sy < mp->sy - 1)
+      relax(ws, mp, weight, pixelIndex, priority, pixelIndex + mp->sx);
+  }
+
+  if (endPixelIndex != -1)
+  {
+    // Walk back once to get the length (and the winning source)
+    int pathSize = 1;
+    int pixelIndex = endPixelIndex;
+    while (ws->parent[pixelIndex] != -1)
     {
-      value = sx + (sy - 1) * mp->sx;
-      totalPriority = priority + weight(mp, pixelIndex, value);
-      if (minHeap->indices[value] != -1)
-      {
-        if (totalPriority < minHeap->arr[minHeap->indices[value]].priority)
-        {
-          heapDecreasePriority(minHeap, value, totalPriority);
-          parentArray[value] = pixelIndex;
-        }
-      }
+      pixelIndex = ws->parent[pixelIndex];
+      pathSize++;
     }
+    int startPixelIndex = pixelIndex;
 
-    if (sx < mp->sx - 1)
+    ws->endPixel = endPixelIndex;
+    ws->pathLength = pathSize;
+
+    if (targetIdx != NULL)
+      *targetIdx = ws->targetSlot[endPixelIndex];
+    if (sourceIdx != NULL)
     {
-      value = (sx + 1) + sy * mp->sx;
-      totalPriority = priority + weight(mp, pixelIndex, value);
-      if (minHeap->indices[value] != -1)
+      for (int i = 0; i < numSources; i++)
       {
-        if (totalPriority < minHeap->arr[minHeap->indices[value]].priority)
+        double cost = sourceCosts == NULL ? 0.0 : sourceCosts[i];
+        if (sources[i] == startPixelIndex &&
+            cost == ws->dist[startPixelIndex])
         {
-          heapDecreasePriority(minHeap, value, totalPriority);
-          parentArray[value] = pixelIndex;
+          *sourceIdx = i;
+          break;
         }
       }
     }
+  }
+
+  return pathWeight;
+}
+
+/**
+ * One-to-many search: the cost from `source` to each of the `numTargets`
+ * pixels in `targets`, written to `costs` (INFINITY for targets that cannot
+ * be reached). Stops as soon as every target has been settled, so nearby
+ * targets are cheaper to ask for than far-away ones.
+ *
+ * Leaves no path in the workspace.
+ */
+void searchWorkspaceAll(SearchWorkspace *ws, Image *mp, WeightFunc weight,
+                        int source, int targets[], int numTargets,
+                        double costs[])
+{
+  workspaceBegin(ws, mp->sx * mp->sy);
+  ws->sx = mp->sx;
+  ws->endPixel = -1;
+  ws->pathLength = 0;
+
+  int remaining = 0;
+  for (int i = 0; i < numTargets; i++)
+  {
+    if (ws->targetStamp[targets[i]] != ws->epoch)
+      remaining++;
+    ws->targetStamp[targets[i]] = ws->epoch;
+  }
+
+  ws->stamp[source] = ws->epoch;
+  ws->dist[source] = 0.0;
+  ws->parent[source] = -1;
+  heapPush(&ws->heap, source, 0.0);
+
+  double priority;
+  while (ws->heap.numItems != 0 && remaining > 0)
+  {
+    int pixelIndex = heapExtractMin(&ws->heap, &priority);
+
+    if (ws->targetStamp[pixelIndex] == ws->epoch)
+      remaining--;
 
+    int sx = pixelIndex % mp->sx;
+    int sy = pixelIndex / mp->sx;
+
+    if (sx > 0)
+      relax(ws, mp, weight, pixelIndex, priority, pixelIndex - 1);
+    if (sy > 0)
+      relax(ws, mp, weight, pixelIndex, priority, pixelIndex - mp->sx);
+    if (sx < mp->sx - 1)
+      relax(ws, mp, weight, pixelIndex, priority, pixelIndex + 1);
     if (sy < mp->sy - 1)
-    {
-      value = sx + (sy + 1) * mp->sx;
-      totalPriority = priority + weight(mp, pixelIndex, value);
-      if (minHeap->indices[value] != -1)
-      {
-        if (totalPriority < minHeap->arr[minHeap->indices[value]].priority)
-        {
-          heapDecreasePriority(minHeap, value, totalPriority);
-          parentArray[value] = pixelIndex;
-        }
-      }
-    }
+      relax(ws, mp, weight, pixelIndex, priority, pixelIndex + mp->sx);
   }
 
-  int pathSize = 0;
+  // Reached pixels that are no longer in the heap have been settled
+  for (int i = 0; i < numTargets; i++)
+  {
+    int p = targets[i];
+    costs[i] = ws->stamp[p] == ws->epoch && ws->heap.indices[p] == -1
+                   ? ws->dist[p]
+                   : INFINITY;
+  }
+}
 
-  pixelIndex = endPixelIndex;
+/**
+ * Number of pixels on the path found by the last search in the workspace,
+ * or 0 if it did not reach a target.
+ */
+int workspacePathLength(SearchWorkspace *ws)
+{
+  return ws->pathLength;
+}
 
-  while (pixelIndex != 0)
+/**
+ * Copy the path found by the last search into `path`, which must have room
+ * for workspacePathLength() entries. No -1 terminator is added.
+ */
+void workspaceCopyPath(SearchWorkspace *ws, int path[])
+{
+  int pixelIndex = ws->endPixel;
+  for (int i = ws->pathLength - 1; i >= 0; i--)
   {
-    pixelIndex = parentArray[pixelIndex];
-    pathSize++;
+    path[i] = pixelIndex;
+    pixelIndex = ws->parent[pixelIndex];
   }
+}
 
-  // when 2 nodes pathSize = 1
+/**
+ * Encode the path found by the last search as a chain code, without going
+ * through an array of pixel indices. Returns NULL if there is no path.
+ */
+PathChain *workspaceChainCode(SearchWorkspace *ws)
+{
+  if (ws->pathLength == 0)
+    return NULL;
 
-  path[pathSize + 1] = -1;
-  path[pathSize] = endPixelIndex;
+  int pixelIndex = ws->endPixel;
+  PathChain *chain = newChainCode(ws->pathLength - 1, ws->sx);
+  for (int i = ws->pathLength - 2; i >= 0; i--)
+  {
+    int parent = ws->parent[pixelIndex];
+    chainCodeSetStep(chain, i, parent, pixelIndex);
+    pixelIndex = parent;
+  }
+  chain->start = pixelIndex;
+  return chain;
+}
 
-  for (int i = pathSize - 1; i >= 0; i--)
+/**
+ * Call `visit(pixelIndex, ctx)` for every pixel on the path found by the
+ * last search, from its source to its target. The parent links only go
+ * backwards, so this keeps a temporary chain code (2 bits per step) rather
+ * than a full array of pixel indices.
+ */
+void workspaceWalkPath(SearchWorkspace *ws, PathVisitor visit, void *ctx)
+{
+  PathChain *chain = workspaceChainCode(ws);
+  if (chain == NULL)
+    return;
+  chainCodeWalk(chain, visit, ctx);
+  freeChainCode(chain);
+}
+
+/**
+ * Weight function that looks up precomputed step costs in im->weightGrid,
+ * which holds 4 costs per pixel: weightGrid[4 * a + d] is the cost of the
+ * step from pixel `a` in direction `d` (CHAIN_RIGHT, CHAIN_DOWN, ... from
+ * chaincode.h). Grids are filled in by buildWeightGrid() (weightexpr.h).
+ */
+double gridWeight(Image *im, int a, int b)
+{
+  int d;
+  if (b == a + im->sx)
+    d = CHAIN_DOWN;
+  else if (b == a - im->sx)
+    d = CHAIN_UP;
+  else if (b == a + 1)
+    d = CHAIN_RIGHT;
+  else
+    d = CHAIN_LEFT;
+  return im->weightGrid[(size_t)4 * a + d];
+}
+
+/**
+ * Weight function for images read with readCostRaster(): the cost of a step
+ * is the cost of the pixel it lands on, straight from the raster.
+ */
+double costWeight(Image *im, int a, int b)
+{
+  return im->costs[(b / im->sx) * im->costStride + b % im->sx];
+}
+
+/**
+ * Evaluate `colourWeight` once for every pair of colours in the image's
+ * palette (see buildPalette()) and cache the costs, for use with
+ * paletteWeight().
+ *
+ * `colourWeight` must only depend on the colours of the two pixels (like
+ * similarColour() or howWhite(), but not allColourWeight()), since it is
+ * called with one representative pixel of each colour.
+ */
+void buildPaletteWeights(Image *im, WeightFunc colourWeight)
+{
+  int k = im->numColours;
+  double *table = malloc((size_t)k * k * sizeof(double));
+  if (table == NULL && k > 0)
   {
-    path[i] = parentArray[path[i + 1]];
+    fprintf(stderr, "buildPaletteWeights(): Out of memory.\n");
+    exit(1);
   }
 
-  return pathWeight; // Replace with cost pf shortest path
+  for (int ca = 0; ca < k; ca++)
+    for (int cb = 0; cb < k; cb++)
+      table[ca * k + cb] = colourWeight(im, im->paletteRep[ca],
+                                        im->paletteRep[cb]);
+
+  free(im->paletteWeights);
+  im->paletteWeights = table;
+}
+
+/**
+ * Weight function that looks up the cost of a step by the colour indices of
+ * its two pixels, in the table made by buildPaletteWeights(). Only touches
+ * one byte per pixel.
+ */
+double paletteWeight(Image *im, int a, int b)
+{
+  return im->paletteWeights[im->colourIndex[a] * im->numColours +
+                            im->colourIndex[b]];
 }
 
 /**
@@ -3,13 +3,67 @@
 
 #include "imgutils.h"
 #include "minheap.h"
+#include "chaincode.h"
 
 // You don't need to understand this syntax, but it essentially
 // defines `WeightFunc` to be a function which expects an Image
 // pointer and two pixel coordinates, and returns a double.
 typedef double (*WeightFunc)(Image *im, int a, int b);
 
+// Per-search state that can be reused across searches (see marcher.c)
+typedef struct
+{
+  int maxPixels;      // Largest image (sx * sy) the arena can hold
+  unsigned int epoch; // Stamp of the current search
+
+  double *dist;              // Cost of reaching each pixel
+  int *parent;               // Previous pixel on the path, -1 for sources
+  int *targetSlot;           // Position of a pixel in the target list
+  unsigned int *stamp;       // stamp[p] == epoch if dist/parent[p] are valid
+  unsigned int *targetStamp; // targetStamp[p] == epoch if p is a target
+  MinHeap heap;              // Frontier (arrays live in the arena)
+
+  int sx;         // Width of the image in the last search
+  int endPixel;   // Target reached by the last search, or -1
+  int pathLength; // Number of pixels on the last path, 0 if none
+
+  void *arena; // Single allocation backing all of the above
+} SearchWorkspace;
+
 double findPath(Image *im, WeightFunc weight, int path[]);
+double findPathMulti(Image *im, WeightFunc weight, int sources[],
+                     double sourceCosts[], int numSources, int targets[],
+                     int numTargets, int path[], int *sourceIdx,
+                     int *targetIdx);
+SearchWorkspace *newWorkspace(int maxPixels);
+void workspaceReserve(SearchWorkspace *ws, int numPixels);
+void workspaceBegin(SearchWorkspace *ws, int numPixels);
+void freeWorkspace(SearchWorkspace *ws);
+double findPathWorkspace(SearchWorkspace *ws, Image *im, WeightFunc weight,
+                         int path[]);
+double findPathMultiWorkspace(SearchWorkspace *ws, Image *im,
+                              WeightFunc weight, int sources[],
+                              double sourceCosts[], int numSources,
+                              int targets[], int numTargets, int path[],
+                              int *sourceIdx, int *targetIdx);
+
+// Searching without a caller-allocated path buffer
+double searchWorkspace(SearchWorkspace *ws, Image *im, WeightFunc weight,
+                       int sources[], double sourceCosts[], int numSources,
+                       int targets[], int numTargets, int *sourceIdx,
+                       int *targetIdx);
+void searchWorkspaceAll(SearchWorkspace *ws, Image *im, WeightFunc weight,
+                        int source, int targets[], int numTargets,
+                        double costs[]);
+int workspacePathLength(SearchWorkspace *ws);
+void workspaceCopyPath(SearchWorkspace *ws, int path[]);
+void workspaceWalkPath(SearchWorkspace *ws, PathVisitor visit, void *ctx);
+PathChain *workspaceChainCode(SearchWorkspace *ws);
+
+double gridWeight(Image *im, int a, int b);
+double costWeight(Image *im, int a, int b);
+void buildPaletteWeights(Image *im, WeightFunc colourWeight);
+double paletteWeight(Image *im, int a, int b);
 double allColourWeight(Image *im, int a, int b);
 
 #endif
@@ -19,6 +19,31 @@ MinHeap *newMinHeap(int size)
   return newMinHeap; // Allocate and return heap.
 }
 
+/**
+ * Grow the heap so it can hold values (and as many items) up to
+ * `maxSize` - 1, keeping its contents. Does nothing if it is already that
+ * big.
+ */
+void heapResize(MinHeap *heap, int maxSize)
+{
+  if (maxSize <= heap->maxSize)
+    return;
+
+  HeapElement *arr = realloc(heap->arr, sizeof(HeapElement) * maxSize);
+  int *indices = realloc(heap->indices, sizeof(int) * maxSize);
+  if (arr == NULL || indices == NULL)
+  {
+    fprintf(stderr, "heapResize(): Out of memory.\n");
+    exit(1);
+  }
+  for (int i = heap->maxSize; i < maxSize; i++)
+    indices[i] = -1;
+
+  heap->arr = arr;
+  heap->indices = indices;
+  heap->maxSize = maxSize;
+}
+
 /**
  * Swaps elements at indices `a` and `b` in the heap, and also updates their
  * indices. Assumes that `a` and `b` are valid.
@@ -151,6 +176,96 @@ void heapDecreasePriority(MinHeap *heap, int val, double priority)
   return; // Decrease priority before return
 }
 
+/**
+ * Restore the heap property over the whole array, bottom-up (Floyd's
+ * method). This is O(numItems), as opposed to O(numItems log numItems) for
+ * pushing the elements one at a time.
+ */
+static void rebuild(MinHeap *heap)
+{
+  for (int i = heap->numItems / 2 - 1; i >= 0; i--)
+    heapify(heap, i);
+}
+
+/**
+ * Is it cheaper to rebuild the whole heap than to fix up `batch` elements
+ * one at a time (about log2(total) swaps each)?
+ */
+static int batchNeedsRebuild(int batch, int total)
+{
+  // Smallest depth >= 1 with 2^depth >= total, without shifting 1 into
+  // the sign bit
+  unsigned int rest = total > 1 ? total - 1 : 0;
+  int depth = 1;
+  while (rest >> depth)
+    depth++;
+  return (long)batch * depth > total;
+}
+
+/**
+ * Replace the contents of the heap with the `n` given (value, priority)
+ * pairs in O(n). The values must be distinct.
+ */
+void heapBuild(MinHeap *heap, int vals[], double priorities[], int n)
+{
+  for (int i = 0; i < heap->numItems; i++)
+    heap->indices[heap->arr[i].val] = -1;
+
+  for (int i = 0; i < n; i++)
+  {
+    heap->arr[i].val = vals[i];
+    heap->arr[i].priority = priorities[i];
+    heap->indices[vals[i]] = i;
+  }
+  heap->numItems = n;
+
+  rebuild(heap);
+}
+
+/**
+ * Push `n` (value, priority) pairs, none of which may already be in the
+ * heap. Large batches are appended and the heap is rebuilt once, small ones
+ * are pushed one at a time.
+ */
+void heapPushBatch(MinHeap *heap, int vals[], double priorities[], int n)
+{
+  if (!batchNeedsRebuild(n, heap->numItems + n))
+  {
+    for (int i = 0; i < n; i++)
+      heapPush(heap, vals[i], priorities[i]);
+    return;
+  }
+
+  for (int i = 0; i < n; i++)
+  {
+    heap->arr[heap->numItems].val = vals[i];
+    heap->arr[heap->numItems].priority = priorities[i];
+    heap->indices[vals[i]] = heap->numItems;
+    heap->numItems++;
+  }
+  rebuild(heap);
+}
+
+/**
+ * Decrease the priorities of `n` values already in the heap. Large batches
+ * update every priority and rebuild the heap once, small ones are done one
+ * at a time.
+ */
+void heapDecreasePriorityBatch(MinHeap *heap, int vals[], double priorities[],
+                               int n)
+{
+  if (!batchNeedsRebuild(n, heap->numItems))
+  {
+    for (int i = 0; i < n; i++)
+      heapDecreasePriority(heap, vals[i], priorities[i]);
+    return;
+  }
+
+  for (int i = 0; i < n; i++)
+    heap->arr[heap->indices[vals[i]]].priority = priorities[i];
+  rebuild(heap);
+}
+
 /**
  * Free the data for the heap. This won't be marked, but it is always good
  * practice to free up after yourself when using a language like C.
@@ -25,10 +25,17 @@ typedef struct
 // Allocate and free
 MinHeap *newMinHeap(int maxSize);
 void freeHeap(MinHeap *heap);
+void heapResize(MinHeap *heap, int maxSize);
 
 // Core heap functions...
 void heapPush(MinHeap *heap, int val, double priority);
 int heapExtractMin(MinHeap *heap, double *priority);
 void heapDecreasePriority(MinHeap *heap, int val, double priority);
 
+// Batch operations, O(n) when the batch is large
+void heapBuild(MinHeap *heap, int vals[], double priorities[], int n);
+void heapPushBatch(MinHeap *heap, int vals[], double priorities[], int n);
+void heapDecreasePriorityBatch(MinHeap *heap, int vals[], double priorities[],
+                               int n);
+
 #endif // __MINHEAP_H__
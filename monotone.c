@@ -0,0 +1,173 @@
+#include "monotone.h"
+#include "rowpass.h"
+
+#include <pthread.h>
+
+// Number of rows whose step costs are evaluated together before the DP
+// consumes them. Keeps the weight buffers small on tall images.
+#define MONOTONE_BAND 128
+
+// A block of rows whose step costs one thread should evaluate
+typedef struct
+{
+  Image *im;
+  WeightFunc weight;
+  int y0, y1;     // Rows [y0, y1) of the image
+  int bandStart;  // First row held by the buffers below
+  double *wDown;  // wDown[x]  = cost of (x, y-1) -> (x, y)
+  double *wRight; // wRight[x] = cost of (x-1, y) -> (x, y)
+  double *wLeft;  // wLeft[x]  = cost of (x+1, y) -> (x, y)
+} MonotoneJob;
+
+static void *evaluateRows(void *arg)
+{
+  MonotoneJob *job = (MonotoneJob *)arg;
+  int sx = job->im->sx;
+
+  for (int y = job->y0; y < job->y1; y++)
+  {
+    int row = (y - job->bandStart) * sx;
+    int p = y * sx;
+    for (int x = 0; x < sx; x++)
+    {
+      job->wDown[row + x] = y > 0 ? job->weight(job->im, p + x - sx, p + x)
+                                  : INFINITY;
+      job->wRight[row + x] = x > 0 ? job->weight(job->im, p + x - 1, p + x)
+                                   : INFINITY;
+      job->wLeft[row + x] = x < sx - 1
+                                ? job->weight(job->im, p + x + 1, p + x)
+                                : INFINITY;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Fill the step costs for rows [y0, y1), splitting the rows between
+ * `numThreads` threads. The weight function is only ever called with the
+ * image, so it is safe to call from several threads at once.
+ */
+static void evaluateBand(MonotoneJob *base, int y0, int y1, int numThreads)
+{
+  if (numThreads > y1 - y0)
+    numThreads = y1 - y0;
+  if (numThreads <= 1)
+  {
+    MonotoneJob job = *base;
+    job.y0 = y0;
+    job.y1 = y1;
+    evaluateRows(&job);
+    return;
+  }
+
+  pthread_t threads[numThreads];
+  MonotoneJob jobs[numThreads];
+  for (int t = 0; t < numThreads; t++)
+  {
+    jobs[t] = *base;
+    jobs[t].y0 = y0 + (y1 - y0) * t / numThreads;
+    jobs[t].y1 = y0 + (y1 - y0) * (t + 1) / numThreads;
+    if (pthread_create(&threads[t], NULL, evaluateRows, &jobs[t]) != 0)
+    {
+      fprintf(stderr, "findMonotonePath(): Unable to create thread.\n");
+      exit(1);
+    }
+  }
+  for (int t = 0; t < numThreads; t++)
+    pthread_join(threads[t], NULL);
+}
+
+/**
+ * Least-energy path from pixel (0,0) to pixel (sx-1, sy-1) when the path is
+ * only allowed to step left, right or down (never up), as in seam carving.
+ *
+ * Uses the same WeightFunc and `path` conventions as findPath(), and gives
+ * the same answer as findPath() with a weight function that returns INFINITY
+ * for upward steps - but instead of a heap it fills in the cost of one row at
+ * a time:
+ *
+ *    - cost[x]  = above[x] + down step       (independent per x, SSE2)
+ *    - cost[x]  = min(cost[x], cost[x-1] + right step)   (left-to-right pass)
+ *    - cost[x]  = min(cost[x], cost[x+1] + left step)    (right-to-left pass)
+ *
+ * Since costs are non-negative a least-energy path never turns back within a
+ * row, so the two passes are enough to make each row exact.
+ *
+ * The weight function is evaluated for bands of rows at a time, and the rows
+ * of each band are split between `numThreads` threads (1 means no threads
+ * are created). The DP itself is sequential from row to row.
+ *
+ * Returns the cost of the path, or INFINITY (with path[0] = -1) if it is
+ * impossible to reach the end.
+ */
+double findMonotonePath(Image *im, WeightFunc weight, int path[],
+                        int numThreads)
+{
+  int sx = im->sx, sy = im->sy;
+  int band = sy < MONOTONE_BAND ? sy : MONOTONE_BAND;
+
+  path[0] = -1;
+
+  double *above = malloc(sizeof(double) * sx);
+  double *cost = malloc(sizeof(double) * sx);
+  double *wDown = malloc(sizeof(double) * sx * band);
+  double *wRight = malloc(sizeof(double) * sx * band);
+  double *wLeft = malloc(sizeof(double) * sx * band);
+  uint8_t *from = malloc(sizeof(uint8_t) * sx * sy);
+  if (!above || !cost || !wDown || !wRight || !wLeft || !from)
+  {
+    fprintf(stderr, "findMonotonePath(): Out of memory.\n");
+    exit(1);
+  }
+
+  MonotoneJob base = {im, weight, 0, 0, 0, wDown, wRight, wLeft};
+
+  for (int x = 0; x < sx; x++)
+    above[x] = INFINITY;
+
+  for (int y = 0; y < sy; y++)
+  {
+    if (y % band == 0)
+    {
+      base.bandStart = y;
+      evaluateBand(&base, y, y + band < sy ? y + band : sy, numThreads);
+    }
+
+    const double *restrict down = &wDown[(y - base.bandStart) * sx];
+    const double *restrict right = &wRight[(y - base.bandStart) * sx];
+    const double *restrict left = &wLeft[(y - base.bandStart) * sx];
+    uint8_t *restrict rowFrom = &from[y * sx];
+
+    // Step down into every pixel of the row at once (two at a time, with
+    // SSE2)
+    for (int x = 0; x < sx; x++)
+      cost[x] = INFINITY;
+    relaxFromRow(sx, above, down, cost, rowFrom, FROM_ABOVE);
+    if (y == 0)
+    {
+      cost[0] = 0.0;
+      rowFrom[0] = FROM_START;
+    }
+
+    // Then allow sideways steps within the row
+    relaxWithinRow(sx, right, left, cost, rowFrom);
+
+    double *temp = above;
+    above = cost;
+    cost = temp;
+  }
+
+  double pathWeight = above[sx - 1];
+
+  if (pathWeight < INFINITY)
+    tracePath(from, sx, sx * sy - 1, path);
+
+  free(from);
+  free(wLeft);
+  free(wRight);
+  free(wDown);
+  free(cost);
+  free(above);
+
+  return pathWeight;
+}
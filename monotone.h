@@ -0,0 +1,9 @@
+#ifndef __MONOTONE_H__
+#define __MONOTONE_H__
+
+#include "marcher.h"
+
+double findMonotonePath(Image *im, WeightFunc weight, int path[],
+                        int numThreads);
+
+#endif // __MONOTONE_H__
@@ -0,0 +1,330 @@
+#include "queries.h"
+
+// Shared state for the threads answering one batch of queries
+typedef struct
+{
+  Image *im; // Shared, read-only
+  WeightFunc weight;
+  PathQuery *queries;
+  int numQueries;
+  int next; // Next query nobody has claimed yet (updated atomically)
+} QueryBatch;
+
+// Shared state for the threads filling in a distance matrix
+typedef struct
+{
+  Image *im;
+  WeightFunc weight;
+  int *points;
+  int numPoints;
+  double *matrix;
+  int next; // Next row nobody has claimed yet (updated atomically)
+} MatrixBatch;
+
+// One pool thread: which pool, and which of its workspaces is its own
+typedef struct
+{
+  QueryPool *pool;
+  int index;
+} PoolThread;
+
+static void queryJob(void *arg, SearchWorkspace *ws)
+{
+  QueryBatch *batch = (QueryBatch *)arg;
+
+  while (1)
+  {
+    int i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+    if (i >= batch->numQueries)
+      break;
+
+    PathQuery *q = &batch->queries[i];
+    q->cost = searchWorkspace(ws, batch->im, batch->weight, &q->source, NULL,
+                              1, &q->target, 1, NULL, NULL);
+    q->pathLength = workspacePathLength(ws);
+    q->path = NULL;
+    if (q->keepPath && q->pathLength > 0)
+    {
+      q->path = malloc(sizeof(int) * q->pathLength);
+      if (q->path == NULL)
+      {
+        fprintf(stderr, "runQueries(): Out of memory.\n");
+        exit(1);
+      }
+      workspaceCopyPath(ws, q->path);
+    }
+  }
+}
+
+static void matrixJob(void *arg, SearchWorkspace *ws)
+{
+  MatrixBatch *batch = (MatrixBatch *)arg;
+  int k = batch->numPoints;
+
+  while (1)
+  {
+    int i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+    if (i >= k)
+      break;
+    searchWorkspaceAll(ws, batch->im, batch->weight, batch->points[i],
+                       batch->points, k, &batch->matrix[(size_t)i * k]);
+  }
+}
+
+/**
+ * Body of each of the pool's threads: sleep until a job is posted, run it
+ * with this thread's workspace, report back, and wait for the next one.
+ */
+static void *poolThread(void *arg)
+{
+  QueryPool *pool = ((PoolThread *)arg)->pool;
+  SearchWorkspace *ws = pool->workspaces[((PoolThread *)arg)->index];
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  while (1)
+  {
+    while (pool->generation == seen && !pool->shutdown)
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    if (pool->shutdown)
+      break;
+    seen = pool->generation;
+
+    pthread_mutex_unlock(&pool->lock);
+    pool->job(pool->batch, ws);
+    pthread_mutex_lock(&pool->lock);
+
+    if (--pool->running == 0)
+      pthread_cond_signal(&pool->done);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+/**
+ * Run `job(batch, workspace)` on every thread of the pool at once, the
+ * calling thread included, and wait for all of them to return. Jobs share
+ * out their work themselves (through an atomic counter in `batch`).
+ */
+static void runPool(QueryPool *pool, void (*job)(void *, SearchWorkspace *),
+                    void *batch)
+{
+  if (pool->numThreads > 1)
+  {
+    pthread_mutex_lock(&pool->lock);
+    pool->job = job;
+    pool->batch = batch;
+    pool->running = pool->numThreads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  job(batch, pool->workspaces[0]);
+
+  if (pool->numThreads > 1)
+  {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0)
+      pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+/**
+ * Make a pool of `numThreads` workers for runQueriesPool(). The calling
+ * thread is the first worker, and the other numThreads - 1 threads are
+ * started here and sleep until there is work, so batches don't pay for
+ * creating threads. Each worker also keeps its SearchWorkspace from one
+ * batch to the next, so repeated batches on the same image don't pay for
+ * allocating search state again.
+ *
+ * A pool runs one batch at a time: it must not be used from several
+ * threads at once.
+ */
+QueryPool *newQueryPool(int numThreads)
+{
+  if (numThreads < 1)
+    numThreads = 1;
+
+  QueryPool *pool = calloc(sizeof(QueryPool), 1);
+  if (pool == NULL ||
+      (pool->workspaces = calloc(sizeof(SearchWorkspace *), numThreads)) ==
+          NULL ||
+      (pool->threads = calloc(sizeof(pthread_t), numThreads)) == NULL ||
+      (pool->threadArgs = calloc(sizeof(PoolThread), numThreads)) == NULL)
+  {
+    fprintf(stderr, "newQueryPool(): Out of memory.\n");
+    exit(1);
+  }
+
+  pool->numThreads = numThreads;
+  for (int t = 0; t < numThreads; t++)
+    pool->workspaces[t] = newWorkspace(0);
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  PoolThread *args = (PoolThread *)pool->threadArgs;
+  for (int t = 1; t < numThreads; t++)
+  {
+    args[t].pool = pool;
+    args[t].index = t;
+    if (pthread_create(&pool->threads[t], NULL, poolThread, &args[t]) != 0)
+    {
+      fprintf(stderr, "newQueryPool(): Unable to create thread.\n");
+      exit(1);
+    }
+  }
+  return pool;
+}
+
+void freeQueryPool(QueryPool *pool)
+{
+  if (pool)
+  {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int t = 1; t < pool->numThreads; t++)
+      pthread_join(pool->threads[t], NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    for (int t = 0; t < pool->numThreads; t++)
+      freeWorkspace(pool->workspaces[t]);
+    free(pool->threadArgs);
+    free(pool->threads);
+    free(pool->workspaces);
+  }
+  free(pool);
+}
+
+/**
+ * Answer many source -> target queries on the same image, spread across the
+ * threads of the pool.
+ *
+ * The image is shared by all of the threads and never modified; each thread
+ * searches with its own workspace, so the weight function just has to be
+ * safe to call concurrently on a read-only image. Threads take the next
+ * unanswered query as they finish the previous one, so uneven queries still
+ * balance out.
+ */
+void runQueriesPool(QueryPool *pool, Image *im, WeightFunc weight,
+                    PathQuery queries[], int numQueries)
+{
+  QueryBatch batch = {im, weight, queries, numQueries, 0};
+  runPool(pool, queryJob, &batch);
+}
+
+/**
+ * runQueriesPool() with a pool of `numThreads` threads made just for this
+ * batch. With numThreads <= 1 the queries are answered on the calling
+ * thread.
+ */
+void runQueries(Image *im, WeightFunc weight, PathQuery queries[],
+                int numQueries, int numThreads)
+{
+  QueryPool *pool = newQueryPool(numThreads);
+  runQueriesPool(pool, im, weight, queries, numQueries);
+  freeQueryPool(pool);
+}
+
+/**
+ * Costs between every pair of the `numPoints` pixels in `points`, as a
+ * (numPoints x numPoints) row-major matrix: matrix[i * numPoints + j] is the
+ * cost from points[i] to points[j] (INFINITY if unreachable). free() it
+ * when done.
+ *
+ * Each row is one search from points[i] that stops once all the points are
+ * settled, rather than numPoints separate searches, and the rows are shared
+ * out between the pool's threads like runQueriesPool().
+ */
+double *distanceMatrixPool(QueryPool *pool, Image *im, WeightFunc weight,
+                           int points[], int numPoints)
+{
+  double *matrix = malloc((size_t)numPoints * numPoints * sizeof(double));
+  if (matrix == NULL)
+  {
+    fprintf(stderr, "distanceMatrix(): Out of memory.\n");
+    exit(1);
+  }
+
+  MatrixBatch batch = {im, weight, points, numPoints, matrix, 0};
+  runPool(pool, matrixJob, &batch);
+  return matrix;
+}
+
+/**
+ * distanceMatrixPool() with a pool of `numThreads` threads made just for
+ * this matrix.
+ */
+double *distanceMatrix(Image *im, WeightFunc weight, int points[],
+                       int numPoints, int numThreads)
+{
+  QueryPool *pool = newQueryPool(numThreads);
+  double *matrix = distanceMatrixPool(pool, im, weight, points, numPoints);
+  freeQueryPool(pool);
+  return matrix;
+}
+
+/**
+ * Least-energy route that visits the `numWaypoints` pixels in `waypoints`
+ * in the given order, made of the cheapest path between each consecutive
+ * pair. The route is stored in a new array in `*path` (free() it when
+ * done), ending with -1 like findPath(); it can visit a pixel more than
+ * once, so it may be longer than the image.
+ *
+ * Returns the total cost, or INFINITY (with (*path)[0] = -1) if some
+ * waypoint cannot be reached from the one before it.
+ */
+double findPathWaypoints(Image *im, WeightFunc weight, int waypoints[],
+                         int numWaypoints, int **path)
+{
+  SearchWorkspace *ws = newWorkspace(im->sx * im->sy);
+  int length = 0, capacity = 1024;
+  int *route = malloc(sizeof(int) * capacity);
+  if (route == NULL)
+  {
+    fprintf(stderr, "findPathWaypoints(): Out of memory.\n");
+    exit(1);
+  }
+
+  double total = 0.0;
+  if (numWaypoints > 0)
+    route[length++] = waypoints[0];
+  for (int i = 0; i + 1 < numWaypoints; i++)
+  {
+    total += searchWorkspace(ws, im, weight, &waypoints[i], NULL, 1,
+                             &waypoints[i + 1], 1, NULL, NULL);
+    int segment = workspacePathLength(ws);
+    if (segment == 0)
+    {
+      total = INFINITY;
+      length = 0;
+      break;
+    }
+
+    // The first pixel of each segment is the end of the previous one
+    if (length + segment > capacity)
+    {
+      while (length + segment > capacity)
+        capacity *= 2;
+      route = realloc(route, sizeof(int) * capacity);
+      if (route == NULL)
+      {
+        fprintf(stderr, "findPathWaypoints(): Out of memory.\n");
+        exit(1);
+      }
+    }
+    workspaceCopyPath(ws, &route[length - 1]);
+    length += segment - 1;
+  }
+  route[length] = -1;
+
+  freeWorkspace(ws);
+  *path = route;
+  return total;
+}
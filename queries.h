@@ -0,0 +1,53 @@
+#ifndef __QUERIES_H__
+#define __QUERIES_H__
+
+#include "marcher.h"
+
+#include <pthread.h>
+
+// One source -> target query for runQueries()
+typedef struct
+{
+  int source, target; // Input: pixel indices
+  int keepPath;       // Input: non-zero to get the path back in `path`
+
+  double cost;    // Output: cost of the path, INFINITY if unreachable
+  int pathLength; // Output: number of pixels on the path
+  int *path;      // Output: the path (if keepPath), free() when done
+} PathQuery;
+
+// Threads and their workspaces, kept around between batches of queries
+typedef struct QueryPool
+{
+  int numThreads;
+  SearchWorkspace **workspaces; // One per thread
+  pthread_t *threads;           // Worker threads 1.. (0 is the caller)
+  void *threadArgs;
+
+  // The current job, posted to the workers under `lock`
+  pthread_mutex_t lock;
+  pthread_cond_t wake; // Signalled when a job is posted, or on shutdown
+  pthread_cond_t done; // Signalled when the last worker finishes a job
+  void (*job)(void *batch, SearchWorkspace *ws);
+  void *batch;
+  unsigned long generation; // Number of jobs posted so far
+  int running;              // Workers still busy with the current job
+  int shutdown;
+} QueryPool;
+
+QueryPool *newQueryPool(int numThreads);
+void freeQueryPool(QueryPool *pool);
+void runQueriesPool(QueryPool *pool, Image *im, WeightFunc weight,
+                    PathQuery queries[], int numQueries);
+void runQueries(Image *im, WeightFunc weight, PathQuery queries[],
+                int numQueries, int numThreads);
+
+// Many-to-many costs, and routes through several points
+double *distanceMatrixPool(QueryPool *pool, Image *im, WeightFunc weight,
+                           int points[], int numPoints);
+double *distanceMatrix(Image *im, WeightFunc weight, int points[],
+                       int numPoints, int numThreads);
+double findPathWaypoints(Image *im, WeightFunc weight, int waypoints[],
+                         int numWaypoints, int **path);
+
+#endif // __QUERIES_H__
@@ -0,0 +1,275 @@
+#include "regions.h"
+
+/**
+ * Uniform-region contraction.
+ *
+ * Images like maze.ppm have large areas of a single colour. With a weight
+ * function that only depends on the colour of the pixel being stepped
+ * *into* (like howWhite()), every step inside such an area costs the same,
+ * say `c`, and the cheapest way across it between two of its border pixels
+ * P and Q is just c * (manhattan distance from P to Q).
+ *
+ * So the areas are covered by rectangles of one colour, and the search
+ * never steps into the interior of a rectangle. Instead, a pixel on the
+ * left / right side of a rectangle can jump straight across to the opposite
+ * side (same row) at a cost of c * width, and one on the top / bottom side
+ * to the opposite side (same column) at c * height. Walking along the
+ * border plus at most one such jump always gives exactly c * manhattan(P, Q)
+ * between any two border pixels, so any path through the interior can be
+ * replaced by one of the same cost along these edges: the result is still
+ * exact, while only the borders of the regions are ever expanded.
+ *
+ * Jumps are expanded back to the individual pixels when the path is written
+ * out.
+ *
+ * The weight function MUST satisfy weight(a, b) == weight(a', b') whenever
+ * b and b' have the same colour (e.g. howWhite(), but not similarColour()).
+ */
+
+static int sameColour(Pixel p, Pixel q)
+{
+  return p.R == q.R && p.G == q.G && p.B == q.B;
+}
+
+/**
+ * Greedily cover the image with rectangles of a single colour: from each
+ * pixel not yet covered (in row-major order), grow a run to the right, then
+ * grow it downwards while the whole run below matches. Only rectangles that
+ * have an interior (at least 3x3) are kept.
+ */
+RegionMap *findUniformRegions(Image *im)
+{
+  int sx = im->sx, sy = im->sy;
+  RegionMap *map = calloc(sizeof(RegionMap), 1);
+  uint8_t *covered = calloc(sizeof(uint8_t), sx * sy);
+  if (map == NULL || covered == NULL)
+  {
+    fprintf(stderr, "findUniformRegions(): Out of memory.\n");
+    exit(1);
+  }
+  map->regionOf = malloc(sizeof(int) * sx * sy);
+  int maxRegions = 64;
+  map->regions = malloc(sizeof(Region) * maxRegions);
+  if (map->regionOf == NULL || map->regions == NULL)
+  {
+    fprintf(stderr, "findUniformRegions(): Out of memory.\n");
+    exit(1);
+  }
+  for (int i = 0; i < sx * sy; i++)
+    map->regionOf[i] = -1;
+
+  for (int y = 0; y < sy; y++)
+  {
+    for (int x = 0; x < sx; x++)
+    {
+      int p = x + y * sx;
+      if (covered[p])
+        continue;
+
+      Pixel col = im->data[p];
+      int x1 = x;
+      while (x1 + 1 < sx && !covered[p + x1 + 1 - x] &&
+             sameColour(im->data[p + x1 + 1 - x], col))
+        x1++;
+
+      int y1 = y;
+      while (y1 + 1 < sy)
+      {
+        int row = (y1 + 1) * sx;
+        int ok = 1;
+        for (int i = x; i <= x1 && ok; i++)
+          ok = !covered[row + i] && sameColour(im->data[row + i], col);
+        if (!ok)
+          break;
+        y1++;
+      }
+
+      int keep = x1 - x >= 2 && y1 - y >= 2;
+      if (keep && map->numRegions == maxRegions)
+      {
+        maxRegions *= 2;
+        map->regions = realloc(map->regions, sizeof(Region) * maxRegions);
+        if (map->regions == NULL)
+        {
+          fprintf(stderr, "findUniformRegions(): Out of memory.\n");
+          exit(1);
+        }
+      }
+
+      for (int j = y; j <= y1; j++)
+        for (int i = x; i <= x1; i++)
+        {
+          covered[i + j * sx] = 1;
+          if (keep)
+            map->regionOf[i + j * sx] = map->numRegions;
+        }
+
+      if (keep)
+      {
+        Region r = {x, y, x1, y1};
+        map->regions[map->numRegions++] = r;
+        map->numInterior += (x1 - x - 1) * (y1 - y - 1);
+      }
+    }
+  }
+
+  free(covered);
+  return map;
+}
+
+void freeRegionMap(RegionMap *map)
+{
+  if (map)
+  {
+    free(map->regions);
+    free(map->regionOf);
+  }
+  free(map);
+}
+
+// Is the pixel at (x, y) strictly inside its region?
+static inline int isInterior(RegionMap *map, int p, int x, int y)
+{
+  int r = map->regionOf[p];
+  if (r < 0)
+    return 0;
+  Region *reg = &map->regions[r];
+  return x > reg->x0 && x < reg->x1 && y > reg->y0 && y < reg->y1;
+}
+
+static void relaxTo(MinHeap *heap, double dist[], int parent[], int p,
+                    double total, int q)
+{
+  if (dist[q] == INFINITY)
+  {
+    if (total < INFINITY)
+    {
+      dist[q] = total;
+      parent[q] = p;
+      heapPush(heap, q, total);
+    }
+  }
+  else if (heap->indices[q] != -1 && total < dist[q])
+  {
+    dist[q] = total;
+    parent[q] = p;
+    heapDecreasePriority(heap, q, total);
+  }
+}
+
+/**
+ * findPath() using the uniform regions in `map` (from findUniformRegions())
+ * to skip region interiors. See the top of this file for the requirements
+ * on the weight function. The path is written pixel by pixel, exactly like
+ * findPath().
+ */
+double findPathRegions(Image *im, WeightFunc weight, RegionMap *map,
+                       int path[])
+{
+  int sx = im->sx, sy = im->sy;
+  int numPixels = sx * sy;
+  int target = numPixels - 1;
+
+  path[0] = -1;
+
+  MinHeap *heap = newMinHeap(numPixels);
+  double *dist = malloc(sizeof(double) * numPixels);
+  int *parent = malloc(sizeof(int) * numPixels);
+  if (dist == NULL || parent == NULL)
+  {
+    fprintf(stderr, "findPathRegions(): Out of memory.\n");
+    exit(1);
+  }
+  for (int i = 0; i < numPixels; i++)
+    dist[i] = INFINITY;
+  dist[0] = 0.0;
+  parent[0] = -1;
+  heapPush(heap, 0, 0.0);
+
+  double priority;
+  int found = 0;
+  while (heap->numItems != 0)
+  {
+    int p = heapExtractMin(heap, &priority);
+    if (p == target)
+    {
+      found = 1;
+      break;
+    }
+
+    int x = p % sx;
+    int y = p / sx;
+
+    // Ordinary steps, except into the interior of a region
+    if (x > 0 && !isInterior(map, p - 1, x - 1, y))
+      relaxTo(heap, dist, parent, p, priority + weight(im, p, p - 1), p - 1);
+    if (y > 0 && !isInterior(map, p - sx, x, y - 1))
+      relaxTo(heap, dist, parent, p, priority + weight(im, p, p - sx),
+              p - sx);
+    if (x < sx - 1 && !isInterior(map, p + 1, x + 1, y))
+      relaxTo(heap, dist, parent, p, priority + weight(im, p, p + 1), p + 1);
+    if (y < sy - 1 && !isInterior(map, p + sx, x, y + 1))
+      relaxTo(heap, dist, parent, p, priority + weight(im, p, p + sx),
+              p + sx);
+
+    // Jumps across the region from its sides
+    int r = map->regionOf[p];
+    if (r >= 0)
+    {
+      Region *reg = &map->regions[r];
+      int w = reg->x1 - reg->x0, h = reg->y1 - reg->y0;
+      if (y > reg->y0 && y < reg->y1)
+      {
+        if (x == reg->x0)
+          relaxTo(heap, dist, parent, p,
+                  priority + w * weight(im, p, p + 1), p + w);
+        else if (x == reg->x1)
+          relaxTo(heap, dist, parent, p,
+                  priority + w * weight(im, p, p - 1), p - w);
+      }
+      if (x > reg->x0 && x < reg->x1)
+      {
+        if (y == reg->y0)
+          relaxTo(heap, dist, parent, p,
+                  priority + h * weight(im, p, p + sx), p + h * sx);
+        else if (y == reg->y1)
+          relaxTo(heap, dist, parent, p,
+                  priority + h * weight(im, p, p - sx), p - h * sx);
+      }
+    }
+  }
+
+  double pathWeight = INFINITY;
+  if (found)
+  {
+    pathWeight = priority;
+
+    // Length, counting every pixel a jump passes over
+    int n = 1;
+    for (int p = target; parent[p] != -1; p = parent[p])
+    {
+      int d = abs(p - parent[p]);
+      n += d < sx ? d : d / sx;
+    }
+
+    // Fill the path from the end, expanding jumps into single steps
+    path[n] = -1;
+    int i = n - 1;
+    for (int p = target; p != -1; p = parent[p])
+    {
+      path[i--] = p;
+      if (parent[p] == -1)
+        break;
+      int diff = p - parent[p];
+      int step = abs(diff) < sx ? (diff > 0 ? 1 : -1) : (diff > 0 ? sx : -sx);
+      for (int q = p - step; q != parent[p]; q -= step)
+        path[i--] = q;
+    }
+  }
+
+  free(parent);
+  free(dist);
+  freeHeap(heap);
+
+  return pathWeight;
+}
@@ -0,0 +1,27 @@
+#ifndef __REGIONS_H__
+#define __REGIONS_H__
+
+#include "marcher.h"
+
+// A rectangle of pixels that all have the same colour
+typedef struct
+{
+  int x0, y0; // Top-left corner (inclusive)
+  int x1, y1; // Bottom-right corner (inclusive)
+} Region;
+
+// Uniform regions found in an image, see findUniformRegions()
+typedef struct
+{
+  int numRegions;
+  Region *regions;
+  int *regionOf; // regionOf[pixIdx] = region containing the pixel, or -1
+  int numInterior; // Pixels strictly inside some region
+} RegionMap;
+
+RegionMap *findUniformRegions(Image *im);
+void freeRegionMap(RegionMap *map);
+double findPathRegions(Image *im, WeightFunc weight, RegionMap *map,
+                       int path[]);
+
+#endif // __REGIONS_H__
@@ -0,0 +1,126 @@
+#include "rowpass.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Row passes shared by the row-at-a-time engines (monotone.c, sweep.c).
+ * Each one works on a row of `n` costs, with `from` holding a FROM_*
+ * direction for every pixel of the row.
+ */
+
+/**
+ * Relax every pixel of a row (`cost`) from the pixel at the same x in
+ * another row (`other`), with step costs `w`, recording `dir` where it
+ * improves. Returns 1 if anything improved.
+ *
+ * Independent for every x, so done two pixels at a time with SSE2 (gcc
+ * does not vectorise it at -O2).
+ */
+int relaxFromRow(int n, const double *restrict other,
+                 const double *restrict w, double *restrict cost,
+                 uint8_t *restrict from, uint8_t dir)
+{
+  int changed = 0;
+  int x = 0;
+#ifdef __SSE2__
+  for (; x + 2 <= n; x += 2)
+  {
+    __m128d c = _mm_add_pd(_mm_loadu_pd(&other[x]), _mm_loadu_pd(&w[x]));
+    __m128d old = _mm_loadu_pd(&cost[x]);
+    __m128d better = _mm_cmplt_pd(c, old);
+    int mask = _mm_movemask_pd(better);
+    if (mask)
+    {
+      _mm_storeu_pd(&cost[x], _mm_or_pd(_mm_and_pd(better, c),
+                                        _mm_andnot_pd(better, old)));
+      if (mask & 1)
+        from[x] = dir;
+      if (mask & 2)
+        from[x + 1] = dir;
+      changed = 1;
+    }
+  }
+#endif
+  for (; x < n; x++)
+  {
+    double c = other[x] + w[x];
+    if (c < cost[x])
+    {
+      cost[x] = c;
+      from[x] = dir;
+      changed = 1;
+    }
+  }
+  return changed;
+}
+
+/**
+ * Relax a row from itself: left-to-right with the step costs `wRight`
+ * ((x-1) -> x), then right-to-left with `wLeft` ((x+1) -> x). Since costs
+ * are non-negative a cheapest path never turns back within a row, so this
+ * makes the row exact given the costs it started with. Returns 1 if
+ * anything improved.
+ */
+int relaxWithinRow(int n, const double *restrict wRight,
+                   const double *restrict wLeft, double *restrict cost,
+                   uint8_t *restrict from)
+{
+  int changed = 0;
+  for (int x = 1; x < n; x++)
+  {
+    double c = cost[x - 1] + wRight[x];
+    if (c < cost[x])
+    {
+      cost[x] = c;
+      from[x] = FROM_LEFT;
+      changed = 1;
+    }
+  }
+  for (int x = n - 2; x >= 0; x--)
+  {
+    double c = cost[x + 1] + wLeft[x];
+    if (c < cost[x])
+    {
+      cost[x] = c;
+      from[x] = FROM_RIGHT;
+      changed = 1;
+    }
+  }
+  return changed;
+}
+
+/**
+ * Follow the directions in `from` (one per pixel of an image `sx` pixels
+ * wide) back from pixel `end` to the FROM_START pixel, and write the path
+ * in order to `path`, ending with -1.
+ */
+void tracePath(const uint8_t *from, int sx, int end, int path[])
+{
+  // Walk back from the end, then reverse into place
+  int n = 0;
+  int pixelIndex = end;
+  while (1)
+  {
+    path[n++] = pixelIndex;
+    uint8_t f = from[pixelIndex];
+    if (f == FROM_START)
+      break;
+    else if (f == FROM_ABOVE)
+      pixelIndex -= sx;
+    else if (f == FROM_BELOW)
+      pixelIndex += sx;
+    else if (f == FROM_LEFT)
+      pixelIndex -= 1;
+    else
+      pixelIndex += 1;
+  }
+  for (int i = 0; i < n / 2; i++)
+  {
+    int temp = path[i];
+    path[i] = path[n - 1 - i];
+    path[n - 1 - i] = temp;
+  }
+  path[n] = -1;
+}
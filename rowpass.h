@@ -0,0 +1,22 @@
+#ifndef __ROWPASS_H__
+#define __ROWPASS_H__
+
+#include <stdint.h>
+
+// Which way the cheapest path entered a pixel (findMonotonePath() never
+// uses FROM_BELOW)
+#define FROM_ABOVE 0
+#define FROM_BELOW 1
+#define FROM_LEFT 2
+#define FROM_RIGHT 3
+#define FROM_START 4
+
+int relaxFromRow(int n, const double *restrict other,
+                 const double *restrict w, double *restrict cost,
+                 uint8_t *restrict from, uint8_t dir);
+int relaxWithinRow(int n, const double *restrict wRight,
+                   const double *restrict wLeft, double *restrict cost,
+                   uint8_t *restrict from);
+void tracePath(const uint8_t *from, int sx, int end, int path[]);
+
+#endif // __ROWPASS_H__
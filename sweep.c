@@ -0,0 +1,201 @@
+#include "sweep.h"
+#include "rowpass.h"
+
+#include <pthread.h>
+
+/**
+ * Wavefront-sweep engine.
+ *
+ * Instead of settling pixels in order of cost with a heap, keep a cost for
+ * every pixel and repeatedly sweep the whole image, relaxing each pixel
+ * from its neighbours, until nothing changes. Each iteration goes down the
+ * image (relaxing every row from the one above, then left-to-right and
+ * right-to-left within the row, with the row passes in rowpass.c shared
+ * with monotone.c) and then back up. A path that only bends a few times is
+ * found in one or two iterations.
+ *
+ * There is no heap, and the row-from-row step is independent for every
+ * pixel, so relaxFromRow() does it two pixels at a time with SSE2. On
+ * dense images where findPath() ends up settling nearly everything anyway
+ * (grad.ppm, water.ppm) this is 2-3 times faster. But every time the best
+ * path has to double back against the sweeps (spiral.ppm needs 12
+ * iterations, mazes more) costs another pass over the whole image: past
+ * about 15 iterations findPath() is faster, and on a serpentine that runs
+ * up and down the image 50 times it is 2.4 times faster.
+ *
+ * With several threads, the rows are split into bands. Each thread sweeps
+ * its own band, then the rows on the edges of the bands are relaxed from
+ * their neighbours in other bands, in two steps so that no row is read
+ * while another thread writes it.
+ */
+
+// State shared by all threads of one search
+typedef struct
+{
+  Image *im;
+  WeightFunc weight;
+  int numThreads;
+  double *cost;
+  uint8_t *from;
+  double *wDown;  // wDown[p]  = cost of (p - sx) -> p
+  double *wUp;    // wUp[p]    = cost of (p + sx) -> p
+  double *wRight; // wRight[p] = cost of (p - 1) -> p
+  double *wLeft;  // wLeft[p]  = cost of (p + 1) -> p
+  pthread_barrier_t barrier;
+  int changed[2][64]; // Per-thread flags, for even and odd iterations
+} SweepState;
+
+// One thread's rows [y0, y1)
+typedef struct
+{
+  SweepState *state;
+  int thread;
+  int y0, y1;
+} SweepBand;
+
+// Relax row y from row y - 1 (dy = -1) or y + 1 (dy = 1), then along itself
+static int relaxRow(SweepState *s, int y, int dy)
+{
+  int sx = s->im->sx;
+  int p = y * sx;
+  int changed = 0;
+  if (dy < 0)
+    changed |= relaxFromRow(sx, &s->cost[p - sx], &s->wDown[p], &s->cost[p],
+                            &s->from[p], FROM_ABOVE);
+  else if (dy > 0)
+    changed |= relaxFromRow(sx, &s->cost[p + sx], &s->wUp[p], &s->cost[p],
+                            &s->from[p], FROM_BELOW);
+  changed |= relaxWithinRow(sx, &s->wRight[p], &s->wLeft[p], &s->cost[p],
+                            &s->from[p]);
+  return changed;
+}
+
+static void *sweepWorker(void *arg)
+{
+  SweepBand *band = (SweepBand *)arg;
+  SweepState *s = band->state;
+  Image *im = s->im;
+  int sx = im->sx, sy = im->sy;
+  int y0 = band->y0, y1 = band->y1;
+
+  // Step costs into this band's pixels
+  for (int y = y0; y < y1; y++)
+    for (int x = 0, p = y * sx; x < sx; x++, p++)
+    {
+      s->wDown[p] = y > 0 ? s->weight(im, p - sx, p) : INFINITY;
+      s->wUp[p] = y < sy - 1 ? s->weight(im, p + sx, p) : INFINITY;
+      s->wRight[p] = x > 0 ? s->weight(im, p - 1, p) : INFINITY;
+      s->wLeft[p] = x < sx - 1 ? s->weight(im, p + 1, p) : INFINITY;
+    }
+
+  for (int iteration = 0;; iteration++)
+  {
+    int changed = 0;
+
+    // Down and back up this band
+    changed |= relaxRow(s, y0, 0);
+    for (int y = y0 + 1; y < y1; y++)
+      changed |= relaxRow(s, y, -1);
+    for (int y = y1 - 2; y >= y0; y--)
+      changed |= relaxRow(s, y, 1);
+
+    // Then the edges from the neighbouring bands: first rows, then last
+    // rows. Bands have at least 2 rows, so these never overlap.
+    pthread_barrier_wait(&s->barrier);
+    if (y0 > 0)
+      changed |= relaxRow(s, y0, -1);
+    pthread_barrier_wait(&s->barrier);
+    if (y1 < sy)
+      changed |= relaxRow(s, y1 - 1, 1);
+
+    s->changed[iteration & 1][band->thread] = changed;
+    pthread_barrier_wait(&s->barrier);
+    int any = 0;
+    for (int t = 0; t < s->numThreads; t++)
+      any |= s->changed[iteration & 1][t];
+    if (!any)
+      break;
+  }
+  return NULL;
+}
+
+/**
+ * Least-energy path from pixel (0,0) to pixel (sx-1, sy-1), like findPath()
+ * (same WeightFunc and `path` conventions, same cost), computed by sweeping
+ * the whole image until the costs converge (see above). The rows are split
+ * between `numThreads` threads (1 means no threads are created).
+ *
+ * Needs 41 bytes per pixel: the cost, 4 step costs and a parent direction.
+ */
+double findPathSweep(Image *im, WeightFunc weight, int path[],
+                     int numThreads)
+{
+  int sx = im->sx, sy = im->sy;
+  int numPixels = sx * sy;
+
+  path[0] = -1;
+
+  // Every band needs at least 2 rows
+  if (numThreads > sy / 2)
+    numThreads = sy / 2;
+  if (numThreads > 64)
+    numThreads = 64;
+  if (numThreads < 1)
+    numThreads = 1;
+
+  SweepState s = {im, weight, numThreads};
+  s.cost = malloc(sizeof(double) * numPixels);
+  s.from = malloc(sizeof(uint8_t) * numPixels);
+  s.wDown = malloc(sizeof(double) * numPixels);
+  s.wUp = malloc(sizeof(double) * numPixels);
+  s.wRight = malloc(sizeof(double) * numPixels);
+  s.wLeft = malloc(sizeof(double) * numPixels);
+  if (!s.cost || !s.from || !s.wDown || !s.wUp || !s.wRight || !s.wLeft)
+  {
+    fprintf(stderr, "findPathSweep(): Out of memory.\n");
+    exit(1);
+  }
+  for (int i = 0; i < numPixels; i++)
+    s.cost[i] = INFINITY;
+  s.cost[0] = 0.0;
+  s.from[0] = FROM_START;
+  pthread_barrier_init(&s.barrier, NULL, numThreads);
+
+  SweepBand bands[numThreads];
+  for (int t = 0; t < numThreads; t++)
+  {
+    bands[t].state = &s;
+    bands[t].thread = t;
+    bands[t].y0 = sy * t / numThreads;
+    bands[t].y1 = sy * (t + 1) / numThreads;
+  }
+  if (numThreads == 1)
+    sweepWorker(&bands[0]);
+  else
+  {
+    pthread_t threads[numThreads];
+    for (int t = 0; t < numThreads; t++)
+      if (pthread_create(&threads[t], NULL, sweepWorker, &bands[t]) != 0)
+      {
+        fprintf(stderr, "findPathSweep(): Unable to create thread.\n");
+        exit(1);
+      }
+    for (int t = 0; t < numThreads; t++)
+      pthread_join(threads[t], NULL);
+  }
+  pthread_barrier_destroy(&s.barrier);
+
+  double pathWeight = s.cost[numPixels - 1];
+
+  if (pathWeight < INFINITY)
+    tracePath(s.from, sx, numPixels - 1, path);
+
+  free(s.wLeft);
+  free(s.wRight);
+  free(s.wUp);
+  free(s.wDown);
+  free(s.from);
+  free(s.cost);
+
+  return pathWeight;
+}
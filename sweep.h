@@ -0,0 +1,9 @@
+#ifndef __SWEEP_H__
+#define __SWEEP_H__
+
+#include "marcher.h"
+
+double findPathSweep(Image *im, WeightFunc weight, int path[],
+                     int numThreads);
+
+#endif // __SWEEP_H__
@@ -1,4 +1,15 @@
 #include "marcher.h"
+#include "monotone.h"
+#include "compact.h"
+#include "weightexpr.h"
+#include "tiled.h"
+#include "queries.h"
+#include "regions.h"
+#include "landmarks.h"
+#include "anytime.h"
+#include "sweep.h"
+#include "turns.h"
+#include "isochrone.h"
 #include "unittest.h"
 
 /****************************** Weight Functions *****************************/
@@ -36,8 +47,15 @@ double howWhite(Image *im, int a, int b)
 void run_test(char *filename, WeightFunc wf, double expectedCost)
 {
   Image *img = readPPMimage(filename);
-  int *path = calloc(sizeof(int), img->sx * img->sy);
-  double cost = findPath(img, wf, path);
+  SearchWorkspace *ws = newWorkspace(img->sx * img->sy);
+  int source = 0, target = img->sx * img->sy - 1;
+  double cost = searchWorkspace(ws, img, wf, &source, NULL, 1, &target, 1,
+                                NULL, NULL);
+  int length = workspacePathLength(ws);
+  int *path = calloc(sizeof(int), length + 1);
+  workspaceCopyPath(ws, path);
+  path[length] = -1;
+  freeWorkspace(ws);
   outputPath(path, img);
   if (fabs(cost - expectedCost) >= 10e-4)
     TEST_FAIL("Cost (%f) did not match expected answer (%f).\n",
@@ -63,6 +81,1245 @@ TEST(all_colour_weight)
   freeImage(img);
 }
 
+// Recompute the cost of a path[] by summing the weights along it
+double path_cost(Image *img, WeightFunc wf, int path[])
+{
+  double cost = 0.0;
+  for (int i = 0; path[i] >= 0 && path[i + 1] >= 0; i++)
+    cost += wf(img, path[i], path[i + 1]);
+  return cost;
+}
+
+TEST(multi_single_pair)
+{
+  // One source and one target should behave exactly like findPath()
+  Image *img = readPPMimage("images/water.ppm");
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  int source = 0, target = img->sx * img->sy - 1, si, ti;
+  double cost = findPathMulti(img, similarColour, &source, NULL, 1, &target,
+                              1, path, &si, &ti);
+  if (fabs(cost - 1280.81526) >= 10e-4 || si != 0 || ti != 0)
+    TEST_FAIL("Cost (%f) did not match expected answer.\n", cost);
+  free(path);
+  freeImage(img);
+}
+
+// Takes about 130 ms, with one search per source as a reference
+TEST_BUDGET(multi_left_to_right, 400)
+TEST(multi_left_to_right)
+{
+  // Left edge to right edge in one search, versus one search per source
+  Image *img = readPPMimage("images/grad.ppm");
+  int sx = img->sx, sy = img->sy;
+  int *path = calloc(sizeof(int), sx * sy + 1);
+  int *sources = calloc(sizeof(int), sy);
+  int *targets = calloc(sizeof(int), sy);
+  for (int y = 0; y < sy; y++)
+    sources[y] = y * sx, targets[y] = y * sx + sx - 1;
+
+  double best = INFINITY;
+  for (int y = 0; y < sy; y++)
+  {
+    double c = findPathMulti(img, similarColour, &sources[y], NULL, 1,
+                             targets, sy, path, NULL, NULL);
+    if (c < best)
+      best = c;
+  }
+
+  int si, ti;
+  double cost = findPathMulti(img, similarColour, sources, NULL, sy, targets,
+                              sy, path, &si, &ti);
+  if (fabs(cost - best) >= 10e-4)
+    TEST_FAIL("Multi-source cost (%f) != best single source (%f).\n",
+              cost, best);
+  if (path[0] != sources[si])
+    TEST_FAIL("Path does not start at the winning source.\n");
+  if (fabs(path_cost(img, similarColour, path) - cost) >= 10e-4)
+    TEST_FAIL("Path cost does not match returned cost.\n");
+  int n = 0;
+  while (path[n] >= 0)
+    n++;
+  if (path[n - 1] != targets[ti])
+    TEST_FAIL("Path does not end at the winning target.\n");
+
+  free(targets);
+  free(sources);
+  free(path);
+  freeImage(img);
+}
+
+TEST(multi_source_costs)
+{
+  // A large initial cost on the top-left source should hand the win to the
+  // other one, even though it is further away.
+  Image *img = readPPMimage("images/water.ppm");
+  int n = img->sx * img->sy;
+  int *path = calloc(sizeof(int), n + 1);
+  int sources[] = {0, n - 2};
+  double costs[] = {10000.0, 5.0};
+  int target = n - 1, si, ti;
+  double cost = findPathMulti(img, similarColour, sources, costs, 2, &target,
+                              1, path, &si, &ti);
+  double step = similarColour(img, n - 2, n - 1);
+  if (si != 1 || fabs(cost - (5.0 + step)) >= 10e-4)
+    TEST_FAIL("Source costs were not respected (cost = %f).\n", cost);
+  free(path);
+  freeImage(img);
+}
+
+// similarColour(), but upward steps are not allowed
+double downSimilarColour(Image *im, int a, int b)
+{
+  if (b < a - 1)
+    return INFINITY;
+  return similarColour(im, a, b);
+}
+
+void run_monotone_test(char *filename, int numThreads)
+{
+  Image *img = readPPMimage(filename);
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  double expected = findPath(img, downSimilarColour, path);
+  double cost = findMonotonePath(img, similarColour, path, numThreads);
+  if (fabs(cost - expected) >= 10e-4)
+    TEST_FAIL("Monotone cost (%f) did not match findPath (%f).\n",
+              cost, expected);
+  if (path[0] != 0 || fabs(path_cost(img, similarColour, path) - cost) >= 10e-4)
+    TEST_FAIL("Monotone path is not consistent with its cost.\n");
+  for (int i = 0; path[i + 1] >= 0; i++)
+    if (path[i + 1] < path[i] - 1)
+      TEST_FAIL("Monotone path steps upwards.\n");
+  free(path);
+  freeImage(img);
+}
+
+TEST(monotone_water) { run_monotone_test("images/water.ppm", 1); }
+TEST(monotone_spiral) { run_monotone_test("images/spiral.ppm", 1); }
+TEST(monotone_threads) { run_monotone_test("images/bigmaze.ppm", 4); }
+
+void run_compact_test(char *filename, WeightFunc wf, double expectedCost)
+{
+  Image *img = readPPMimage(filename);
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  double cost = findPathCompact(img, wf, path);
+  if (fabs(cost - expectedCost) >= 10e-4)
+    TEST_FAIL("Compact cost (%f) did not match expected answer (%f).\n",
+              cost, expectedCost);
+  if (path[0] != 0 || fabs(path_cost(img, wf, path) - cost) >= 10e-4)
+    TEST_FAIL("Compact path is not consistent with its cost.\n");
+  free(path);
+  freeImage(img);
+}
+
+TEST(compact_water) { run_compact_test("images/water.ppm", similarColour, 1280.81526); }
+TEST(compact_spiral) { run_compact_test("images/spiral.ppm", similarColour, 991.255407); }
+TEST(compact_bigmaze) { run_compact_test("images/bigmaze.ppm", howWhite, 8.620000); }
+
+TEST(workspace_reuse)
+{
+  // One workspace shared by searches on different images should give the
+  // same answers as fresh searches, including across an epoch wrap-around.
+  char *files[] = {"images/water.ppm", "images/bigmaze.ppm", "images/grad.ppm"};
+  WeightFunc wfs[] = {similarColour, howWhite, similarColour};
+  double expected[] = {1280.81526, 8.620000, 278.751493};
+
+  SearchWorkspace *ws = newWorkspace(16);
+  for (int round = 0; round < 2; round++)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      Image *img = readPPMimage(files[i]);
+      int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+      double cost = findPathWorkspace(ws, img, wfs[i], path);
+      if (fabs(cost - expected[i]) >= 10e-4)
+        TEST_FAIL("Reused workspace cost (%f) != expected (%f) for %s.\n",
+                  cost, expected[i], files[i]);
+      if (fabs(path_cost(img, wfs[i], path) - cost) >= 10e-4)
+        TEST_FAIL("Reused workspace path is not consistent with its cost.\n");
+      free(path);
+      freeImage(img);
+    }
+    ws->epoch = 0xFFFFFFFF; // Force the next search to wrap the stamps
+  }
+  freeWorkspace(ws);
+}
+
+// Collects the pixels visited by workspaceWalkPath() / chainCodeWalk()
+typedef struct
+{
+  int *pixels;
+  int count;
+} PathCollector;
+
+void collect_pixel(int pixelIndex, void *ctx)
+{
+  PathCollector *c = (PathCollector *)ctx;
+  c->pixels[c->count++] = pixelIndex;
+}
+
+TEST(streaming_path)
+{
+  // Every way of reading out the path should agree with findPath()
+  Image *img = readPPMimage("images/spiral.ppm");
+  int n = img->sx * img->sy;
+  int *expected = calloc(sizeof(int), n + 1);
+  findPath(img, similarColour, expected);
+  int length = 0;
+  while (expected[length] >= 0)
+    length++;
+
+  SearchWorkspace *ws = newWorkspace(n);
+  int source = 0, target = n - 1;
+  searchWorkspace(ws, img, similarColour, &source, NULL, 1, &target, 1,
+                  NULL, NULL);
+  if (workspacePathLength(ws) != length)
+    TEST_FAIL("Path length (%d) != findPath length (%d).\n",
+              workspacePathLength(ws), length);
+
+  int *copied = calloc(sizeof(int), length);
+  workspaceCopyPath(ws, copied);
+
+  PathCollector walked = {calloc(sizeof(int), length), 0};
+  workspaceWalkPath(ws, collect_pixel, &walked);
+
+  PathChain *chain = workspaceChainCode(ws);
+  int *decoded = calloc(sizeof(int), length);
+  chainCodeToPath(chain, decoded);
+  PathChain *fromPath = chainCodeFromPath(expected, length, img->sx);
+
+  if (walked.count != length || chain->numSteps != length - 1 ||
+      memcmp(chain->codes, fromPath->codes, (length + 2) / 4) != 0)
+    TEST_FAIL("Walked path or chain code has the wrong length.\n");
+  for (int i = 0; i < length; i++)
+    if (copied[i] != expected[i] || walked.pixels[i] != expected[i] ||
+        decoded[i] != expected[i])
+      TEST_FAIL("Streamed path differs from findPath() at step %d.\n", i);
+
+  freeChainCode(fromPath);
+  freeChainCode(chain);
+  free(decoded);
+  free(walked.pixels);
+  free(copied);
+  freeWorkspace(ws);
+  free(expected);
+  freeImage(img);
+}
+
+TEST(output_path_overlay)
+{
+  // The written image should be the original with only the path repainted
+  Image *img = readPPMimage("images/grad.ppm");
+  int n = img->sx * img->sy;
+  int *path = calloc(sizeof(int), n + 1);
+  findPath(img, similarColour, path);
+  outputPath(path, img);
+
+  Image *out = readPPMimage("Path-grad.ppm");
+  char *onPath = calloc(1, n);
+  int length = 0;
+  while (path[length] >= 0)
+    onPath[path[length++]] = 1;
+
+  for (int i = 0; i < n; i++)
+  {
+    Pixel a = getPixel(img, i), b = getPixel(out, i);
+    if (!onPath[i] && (a.R != b.R || a.G != b.G || a.B != b.B))
+      TEST_FAIL("Pixel %d off the path was changed.\n", i);
+  }
+  for (int p = 0; p < length; p++)
+  {
+    Pixel b = getPixel(out, path[p]);
+    if (b.R != 0 || b.B != 0 || b.G != (uint8_t)(255 - p * (120.0 / length)))
+      TEST_FAIL("Path pixel %d has the wrong colour.\n", p);
+  }
+
+  free(onPath);
+  freeImage(out);
+  free(path);
+  freeImage(img);
+}
+
+void run_expr_test(char *filename, char *text, double expectedCost)
+{
+  char error[256];
+  WeightExpr *expr = compileWeightExpr(text, error, sizeof(error));
+  if (expr == NULL)
+    TEST_FAIL("Could not compile \"%s\": %s\n", text, error);
+
+  Image *img = readPPMimage(filename);
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  buildWeightGrid(img, expr);
+  double cost = findPath(img, gridWeight, path);
+  if (fabs(cost - expectedCost) >= 10e-4)
+    TEST_FAIL("Expression cost (%f) did not match expected answer (%f).\n",
+              cost, expectedCost);
+  free(path);
+  freeImage(img);
+  freeWeightExpr(expr);
+}
+
+TEST(expr_similar_colour)
+{
+  run_expr_test("images/water.ppm",
+                "sqrt((r1-r2)^2 + (g1-g2)^2 + (b1-b2)^2) + 0.01", 1280.81526);
+}
+
+TEST(expr_how_white)
+{
+  run_expr_test("images/maze.ppm",
+                "sqrt(((255-r2)^2 + (255-g2)^2 + (255-b2)^2) / 100) + 0.01",
+                12.400000);
+}
+
+TEST(expr_matches_weight_function)
+{
+  // Every operator and variable, checked against the same formula in C
+  Image *img = readPPMimage("images/grad.ppm");
+  WeightExpr *expr = compileWeightExpr(
+      "max(abs(r1 - b2) / 2, -g1 + 300, min(x1, y2, 7)) + 2^0.5 * x2 - y1",
+      NULL, 0);
+  double out[3];
+  int a = 5 * img->sx + 3;
+  weightExprEval(expr, img, a, a + 1, 3, out);
+  for (int i = 0; i < 3; i++)
+  {
+    Pixel p = getPixel(img, a + i), q = getPixel(img, a + 1 + i);
+    int x1 = (a + i) % img->sx, y1 = (a + i) / img->sx;
+    int x2 = (a + 1 + i) % img->sx, y2 = (a + 1 + i) / img->sx;
+    double m = fmin(fmin(x1, y2), 7);
+    double v = fmax(fmax(fabs(p.R - q.B) / 2.0, -p.G + 300.0), m) +
+               pow(2, 0.5) * x2 - y1;
+    if (fabs(out[i] - v) >= 1e-9)
+      TEST_FAIL("Expression gave %f, expected %f.\n", out[i], v);
+  }
+  freeWeightExpr(expr);
+
+  char *bad[] = {"", "r1 +", "sqrt(r1, r2)", "min(r1)", "foo", "(r1", "r1 r2"};
+  for (int i = 0; i < 7; i++)
+    if (compileWeightExpr(bad[i], NULL, 0) != NULL)
+      TEST_FAIL("\"%s\" should not compile.\n", bad[i]);
+  freeImage(img);
+}
+
+void run_palette_test(char *filename, WeightFunc wf, int expectedColours)
+{
+  Image *img = readPPMimage(filename);
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  double expected = findPath(img, wf, path);
+
+  int k = buildPalette(img, 256);
+  if (k != expectedColours)
+    TEST_FAIL("Found %d colours, expected %d.\n", k, expectedColours);
+  for (int i = 0; i < img->sx * img->sy; i++)
+  {
+    Pixel p = getPixel(img, i), q = img->palette[img->colourIndex[i]];
+    if (p.R != q.R || p.G != q.G || p.B != q.B)
+      TEST_FAIL("Pixel %d has the wrong colour index.\n", i);
+  }
+
+  buildPaletteWeights(img, wf);
+  double cost = findPath(img, paletteWeight, path);
+  if (fabs(cost - expected) >= 10e-4)
+    TEST_FAIL("Palette cost (%f) did not match expected answer (%f).\n",
+              cost, expected);
+  free(path);
+  freeImage(img);
+}
+
+TEST(palette_maze) { run_palette_test("images/maze.ppm", howWhite, 47); }
+TEST(palette_bigmaze) { run_palette_test("images/bigmaze.ppm", howWhite, 2); }
+TEST(palette_25colours) { run_palette_test("images/25colours.ppm", similarColour, 25); }
+
+TEST(palette_too_many_colours)
+{
+  Image *img = readPPMimage("images/water.ppm");
+  if (buildPalette(img, 256) != 0 || img->numColours != 0)
+    TEST_FAIL("water.ppm should have too many colours for a palette.\n");
+  freeImage(img);
+}
+
+void run_tiled_test(char *filename, WeightFunc wf, double expectedCost)
+{
+  Image *img = readPPMimage(filename);
+  Image *tiled = tileImage(img);
+  for (int y = 0; y < img->sy; y++)
+    for (int x = 0; x < img->sx; x++)
+    {
+      Pixel p = getPixel(img, x + y * img->sx);
+      Pixel q = getPixel(tiled, tiledIndex(img, x, y));
+      if (p.R != q.R || p.G != q.G || p.B != q.B)
+        TEST_FAIL("Pixel (%d, %d) was not tiled correctly.\n", x, y);
+    }
+
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  double cost = findPathTiled(tiled, wf, path);
+  if (fabs(cost - expectedCost) >= 10e-4)
+    TEST_FAIL("Tiled cost (%f) did not match expected answer (%f).\n",
+              cost, expectedCost);
+  if (path[0] != 0 || fabs(path_cost(img, wf, path) - cost) >= 10e-4)
+    TEST_FAIL("Tiled path is not consistent with its cost.\n");
+  free(path);
+  freeImage(tiled);
+  freeImage(img);
+}
+
+TEST(tiled_water) { run_tiled_test("images/water.ppm", similarColour, 1280.81526); }
+TEST(tiled_spiral) { run_tiled_test("images/spiral.ppm", similarColour, 991.255407); }
+TEST(tiled_bigmaze) { run_tiled_test("images/bigmaze.ppm", howWhite, 8.620000); }
+
+// Random queries between pixels up to `range` apart in x and y
+PathQuery *random_queries(Image *img, int numQueries, int range)
+{
+  PathQuery *queries = calloc(sizeof(PathQuery), numQueries);
+  srand(7);
+  for (int i = 0; i < numQueries; i++)
+  {
+    int x = rand() % img->sx, y = rand() % img->sy;
+    int tx = x + rand() % (2 * range + 1) - range;
+    int ty = y + rand() % (2 * range + 1) - range;
+    tx = tx < 0 ? 0 : tx >= img->sx ? img->sx - 1 : tx;
+    ty = ty < 0 ? 0 : ty >= img->sy ? img->sy - 1 : ty;
+    queries[i].source = x + y * img->sx;
+    queries[i].target = tx + ty * img->sx;
+  }
+  return queries;
+}
+
+TEST(concurrent_queries)
+{
+  // Queries answered by several threads should match one at a time
+  Image *img = readPPMimage("images/grad.ppm");
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  PathQuery *queries = random_queries(img, 64, 50);
+  for (int i = 0; i < 64; i++)
+    queries[i].keepPath = 1;
+
+  runQueries(img, similarColour, queries, 64, 4);
+
+  for (int i = 0; i < 64; i++)
+  {
+    PathQuery *q = &queries[i];
+    double cost = findPathMulti(img, similarColour, &q->source, NULL, 1,
+                                &q->target, 1, path, NULL, NULL);
+    if (fabs(cost - q->cost) >= 10e-4)
+      TEST_FAIL("Query %d cost (%f) != findPathMulti (%f).\n", i, q->cost,
+                cost);
+    double c = 0.0;
+    for (int j = 0; j + 1 < q->pathLength; j++)
+      c += similarColour(img, q->path[j], q->path[j + 1]);
+    if (q->path[0] != q->source || q->path[q->pathLength - 1] != q->target ||
+        fabs(c - cost) >= 10e-4)
+      TEST_FAIL("Query %d path is not consistent with its cost.\n", i);
+    free(q->path);
+  }
+
+  free(queries);
+  free(path);
+  freeImage(img);
+}
+
+TEST(query_pool_reuse)
+{
+  // The same pool's threads answer batch after batch, fewer queries than
+  // threads included
+  Image *img = readPPMimage("images/grad.ppm");
+  PathQuery *queries = random_queries(img, 32, 50);
+  PathQuery *again = random_queries(img, 32, 50);
+  QueryPool *pool = newQueryPool(3);
+
+  runQueriesPool(pool, img, similarColour, queries, 32);
+  for (int batch = 0; batch < 20; batch++)
+    runQueriesPool(pool, img, similarColour, again, batch % 2 ? 2 : 32);
+  for (int i = 0; i < 32; i++)
+    if (again[i].cost != queries[i].cost)
+      TEST_FAIL("Query %d changed cost when the pool was reused.\n", i);
+
+  freeQueryPool(pool);
+  free(again);
+  free(queries);
+  freeImage(img);
+}
+
+void run_regions_test(char *filename, double expectedCost)
+{
+  Image *img = readPPMimage(filename);
+  RegionMap *map = findUniformRegions(img);
+  if (map->numInterior == 0)
+    TEST_FAIL("No uniform regions found in %s.\n", filename);
+
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  double cost = findPathRegions(img, howWhite, map, path);
+  if (fabs(cost - expectedCost) >= 10e-4)
+    TEST_FAIL("Region cost (%f) did not match expected answer (%f).\n",
+              cost, expectedCost);
+  if (path[0] != 0 || fabs(path_cost(img, howWhite, path) - cost) >= 10e-4)
+    TEST_FAIL("Region path is not consistent with its cost.\n");
+  for (int i = 0; path[i + 1] >= 0; i++)
+  {
+    int d = abs(path[i + 1] - path[i]);
+    if (d != 1 && d != img->sx)
+      TEST_FAIL("Region path was not expanded to single steps.\n");
+  }
+  free(path);
+  freeRegionMap(map);
+  freeImage(img);
+}
+
+TEST(regions_maze) { run_regions_test("images/maze.ppm", 12.400000); }
+TEST(regions_bigmaze) { run_regions_test("images/bigmaze.ppm", 8.620000); }
+
+void run_landmarks_test(char *filename, WeightFunc wf)
+{
+  Image *img = readPPMimage(filename);
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  Landmarks *lm = buildLandmarks(img, wf, 8, 2);
+  SearchWorkspace *ws = newWorkspace(0);
+  PathQuery *queries = random_queries(img, 20, img->sx);
+  queries[0].source = 0, queries[0].target = img->sx * img->sy - 1;
+
+  for (int i = 0; i < 20; i++)
+  {
+    int s = queries[i].source, t = queries[i].target;
+    double expected = findPathMulti(img, wf, &s, NULL, 1, &t, 1, path, NULL,
+                                    NULL);
+    if (landmarkHeuristic(lm, s, t) > expected)
+      TEST_FAIL("Landmark bound is larger than the actual cost.\n");
+    double cost = findPathLandmarks(ws, img, wf, lm, s, t, path);
+    if (fabs(cost - expected) >= 10e-4)
+      TEST_FAIL("Landmark cost (%f) did not match findPathMulti (%f).\n",
+                cost, expected);
+    if (path[0] != s || fabs(path_cost(img, wf, path) - cost) >= 10e-4)
+      TEST_FAIL("Landmark path is not consistent with its cost.\n");
+    if (workspacePathLength(ws) < 1 || path[workspacePathLength(ws)] != -1)
+      TEST_FAIL("Landmark path is not left in the workspace.\n");
+  }
+
+  free(queries);
+  freeWorkspace(ws);
+  freeLandmarks(lm);
+  free(path);
+  freeImage(img);
+}
+
+TEST(landmarks_water) { run_landmarks_test("images/water.ppm", similarColour); }
+TEST(landmarks_spiral) { run_landmarks_test("images/spiral.ppm", similarColour); }
+TEST(landmarks_all_colour) { run_landmarks_test("images/25colours.ppm", allColourWeight); }
+
+void run_anytime_test(char *filename, WeightFunc wf, double minStep)
+{
+  Image *img = readPPMimage(filename);
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  double expectedCost = findPath(img, wf, path);
+  int target = img->sx * img->sy - 1;
+  Landmarks *lm = minStep > 0 ? buildLandmarks(img, wf, 4, 1) : NULL;
+  double bound;
+
+  // With plenty of time, the final pass is optimal
+  double cost = findPathAnytime(img, wf, NULL, minStep, 0, target, 1e6, path,
+                                &bound);
+  if (fabs(cost - expectedCost) >= 10e-4 || bound != 1.0)
+    TEST_FAIL("Anytime cost (%f, bound %f) is not optimal (%f).\n", cost,
+              bound, expectedCost);
+  if (fabs(path_cost(img, wf, path) - cost) >= 10e-4)
+    TEST_FAIL("Anytime path is not consistent with its cost.\n");
+
+  // With no time at all, whatever comes back must be within its bound
+  cost = findPathAnytime(img, wf, lm, minStep, 0, target, 0.0, path, &bound);
+  if (cost < INFINITY)
+  {
+    if (bound < 1.0 || cost > bound * expectedCost + 10e-4)
+      TEST_FAIL("Anytime cost (%f) is outside its bound (%f).\n", cost,
+                bound);
+    if (fabs(path_cost(img, wf, path) - cost) >= 10e-4)
+      TEST_FAIL("Anytime path is not consistent with its cost.\n");
+  }
+
+  freeLandmarks(lm);
+  free(path);
+  freeImage(img);
+}
+
+// Cost of stepping onto a pixel by how dark it is: white pixels are free
+double howDark(Image *im, int a, int b)
+{
+  return (255 - getPixel(im, b).R) / 255.0;
+}
+
+TEST(anytime_zero_weights)
+{
+  // A third of the pixels are free, so many pixels have g + h == 0, and
+  // the top row is a free path between its two ends
+  Image *img = newImage(40, 40);
+  srand(5);
+  for (int i = 0; i < 40 * 40; i++)
+  {
+    uint8_t v = i < 40 || rand() % 3 == 0 ? 255 : 64 + rand() % 128;
+    img->data[i].R = img->data[i].G = img->data[i].B = v;
+  }
+  int *path = calloc(sizeof(int), 40 * 40 + 1);
+  Landmarks *lm = buildLandmarks(img, howDark, 3, 1);
+  SearchWorkspace *ws = newWorkspace(40 * 40);
+
+  for (int i = 0; i < 50; i++)
+  {
+    int source = i == 0 ? 0 : rand() % (40 * 40);
+    int target = i == 0 ? 39 : rand() % (40 * 40);
+    double expected = findPathMultiWorkspace(ws, img, howDark, &source, NULL,
+                                             1, &target, 1, path, NULL, NULL);
+
+    // Only the first pass, where the bound has to come from the heap
+    double bound;
+    double cost = findPathAnytime(img, howDark, lm, 0.0, source, target, 0.0,
+                                  path, &bound);
+    if (cost > bound * expected + 10e-4)
+      TEST_FAIL("Anytime cost (%f) is outside its bound (%f x %f).\n", cost,
+                bound, expected);
+    if (bound == 1.0 && fabs(cost - expected) >= 10e-4)
+      TEST_FAIL("Anytime path (%f) is called optimal but is not (%f).\n",
+                cost, expected);
+    if (expected == 0.0 && (cost != 0.0 || bound != 1.0))
+      TEST_FAIL("Free path cost %f with bound %f.\n", cost, bound);
+  }
+
+  freeWorkspace(ws);
+  freeLandmarks(lm);
+  free(path);
+  freeImage(img);
+}
+
+TEST(anytime_water) { run_anytime_test("images/water.ppm", similarColour, 0.01); }
+TEST(anytime_spiral) { run_anytime_test("images/spiral.ppm", similarColour, 0.01); }
+TEST(anytime_all_colour) { run_anytime_test("images/25colours.ppm", allColourWeight, 0.0); }
+
+void run_sweep_test(char *filename, WeightFunc wf, int numThreads,
+                    double expectedCost)
+{
+  Image *img = readPPMimage(filename);
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  double cost = findPathSweep(img, wf, path, numThreads);
+  if (fabs(cost - expectedCost) >= 10e-4)
+    TEST_FAIL("Sweep cost (%f) did not match expected (%f).\n", cost,
+              expectedCost);
+  if (path[0] != 0 || fabs(path_cost(img, wf, path) - cost) >= 10e-4)
+    TEST_FAIL("Sweep path is not consistent with its cost.\n");
+  free(path);
+  freeImage(img);
+}
+
+TEST(sweep_water) { run_sweep_test("images/water.ppm", similarColour, 1, 1280.81526); }
+TEST(sweep_spiral) { run_sweep_test("images/spiral.ppm", similarColour, 1, 991.255407); }
+TEST(sweep_grad) { run_sweep_test("images/grad.ppm", similarColour, 1, 278.751493); }
+TEST(sweep_maze_threads) { run_sweep_test("images/maze.ppm", howWhite, 3, 12.400000); }
+TEST(sweep_water_threads) { run_sweep_test("images/water.ppm", similarColour, 4, 1280.81526); }
+
+// Number of 90 degree turns along a path[] (a reversal counts as 2)
+int count_turns(int path[])
+{
+  int turns = 0;
+  for (int i = 0; path[i] >= 0 && path[i + 1] >= 0 && path[i + 2] >= 0; i++)
+  {
+    int a = path[i + 1] - path[i], b = path[i + 2] - path[i + 1];
+    turns += a == b ? 0 : a == -b ? 2 : 1;
+  }
+  return turns;
+}
+
+void run_turns_test(char *filename, WeightFunc wf, double turnCost,
+                    int maxTurns)
+{
+  Image *img = readPPMimage(filename);
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  double plain = findPath(img, wf, path);
+  double cost = findPathTurns(img, wf, turnCost, path);
+  if (turnCost == 0.0 && fabs(cost - plain) >= 10e-4)
+    TEST_FAIL("Turn cost (%f) did not match findPath (%f).\n", cost, plain);
+  if (cost < plain - 10e-4)
+    TEST_FAIL("Turn cost (%f) is below findPath (%f).\n", cost, plain);
+  int turns = count_turns(path);
+  if (path[0] != 0 ||
+      fabs(path_cost(img, wf, path) + turns * turnCost - cost) >= 10e-4)
+    TEST_FAIL("Turn path is not consistent with its cost.\n");
+  if (turns > maxTurns)
+    TEST_FAIL("Turn path has %d turns, expected at most %d.\n", turns,
+              maxTurns);
+  free(path);
+  freeImage(img);
+}
+
+TEST(turns_free) { run_turns_test("images/water.ppm", similarColour, 0.0, 1 << 30); }
+TEST(turns_maze) { run_turns_test("images/maze.ppm", howWhite, 5.0, 1 << 30); }
+TEST(turns_expensive) { run_turns_test("images/water.ppm", similarColour, 1e6, 1); }
+
+// One pixel of each colour of 25colours.ppm, from its palette
+int *palette_points(Image *img, int *numPoints)
+{
+  *numPoints = buildPalette(img, 256);
+  int *points = malloc(sizeof(int) * *numPoints);
+  for (int i = 0; i < *numPoints; i++)
+    points[i] = img->paletteRep[i];
+  return points;
+}
+
+TEST(distance_matrix)
+{
+  Image *img = readPPMimage("images/25colours.ppm");
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  int k;
+  int *points = palette_points(img, &k);
+  double *matrix = distanceMatrix(img, similarColour, points, k, 3);
+
+  for (int i = 0; i < k; i += 3)
+    for (int j = 0; j < k; j += 4)
+    {
+      double expected = findPathMulti(img, similarColour, &points[i], NULL, 1,
+                                      &points[j], 1, path, NULL, NULL);
+      if (fabs(matrix[i * k + j] - expected) >= 10e-4)
+        TEST_FAIL("Matrix cost %d -> %d (%f) did not match findPathMulti "
+                  "(%f).\n", i, j, matrix[i * k + j], expected);
+    }
+
+  free(matrix);
+  free(points);
+  free(path);
+  freeImage(img);
+}
+
+TEST(waypoints)
+{
+  Image *img = readPPMimage("images/25colours.ppm");
+  int k;
+  int *points = palette_points(img, &k);
+  double *matrix = distanceMatrix(img, similarColour, points, k, 1);
+  int order[] = {0, 7, 3, 24, 12, 3};
+
+  double expected = 0.0;
+  for (int i = 0; i + 1 < 6; i++)
+    expected += matrix[order[i] * k + order[i + 1]];
+  int waypoints[6];
+  for (int i = 0; i < 6; i++)
+    waypoints[i] = points[order[i]];
+
+  int *route;
+  double cost = findPathWaypoints(img, similarColour, waypoints, 6, &route);
+  if (fabs(cost - expected) >= 10e-4)
+    TEST_FAIL("Waypoint cost (%f) did not match the matrix (%f).\n", cost,
+              expected);
+  if (route[0] != waypoints[0] ||
+      fabs(path_cost(img, similarColour, route) - cost) >= 10e-4)
+    TEST_FAIL("Waypoint route is not consistent with its cost.\n");
+
+  // Every waypoint is visited, in order
+  int next = 1, n;
+  for (n = 0; route[n] >= 0; n++)
+    if (next < 6 && route[n] == waypoints[next])
+      next++;
+  if (next != 6 || route[n - 1] != waypoints[5])
+    TEST_FAIL("Waypoint route skips waypoints.\n");
+
+  free(route);
+  free(matrix);
+  free(points);
+  freeImage(img);
+}
+
+// The cost of stepping onto each pixel of `img` with howWhite(), as floats
+float *howWhite_costs(Image *img)
+{
+  float *costs = malloc(sizeof(float) * img->sx * img->sy);
+  for (int i = 0; i < img->sx * img->sy; i++)
+    costs[i] = howWhite(img, 0, i);
+  return costs;
+}
+
+double float_how_white(Image *im, int a, int b)
+{
+  return (float)howWhite(im, a, b);
+}
+
+// Write `costs` as a cost raster, or as a PFM with the given scale
+void write_costs(char *filename, float *costs, int sx, int sy, char *pfmScale)
+{
+  FILE *f = fopen(filename, "wb");
+  if (pfmScale == NULL)
+  {
+    int32_t header[4] = {0, sx, sy, 0};
+    memcpy(header, "CRF1", 4);
+    fwrite(header, sizeof(header), 1, f);
+    fwrite(costs, sizeof(float), sx * sy, f);
+  }
+  else
+  {
+    fprintf(f, "Pf\n%d %d\n%s\n", sx, sy, pfmScale);
+    for (int y = sy - 1; y >= 0; y--)
+      for (int x = 0; x < sx; x++)
+      {
+        uint8_t *b = (uint8_t *)&costs[y * sx + x];
+        if (pfmScale[0] == '-')
+          fwrite(b, 1, 4, f);
+        else
+          for (int i = 3; i >= 0; i--)
+            fwrite(&b[i], 1, 1, f);
+      }
+  }
+  fclose(f);
+}
+
+void run_cost_raster_test(char *pfmScale)
+{
+  Image *img = readPPMimage("images/maze.ppm");
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  float *costs = howWhite_costs(img);
+  double expected = findPath(img, float_how_white, path);
+
+  write_costs("maze-costs.tmp", costs, img->sx, img->sy, pfmScale);
+  Image *raster = readCostRaster("maze-costs.tmp");
+  remove("maze-costs.tmp");
+  if (raster->sx != img->sx || raster->sy != img->sy || raster->data)
+    TEST_FAIL("Cost raster has the wrong shape.\n");
+  for (int i = 0; i < img->sx * img->sy; i++)
+    if (costWeight(raster, 0, i) != costs[i])
+      TEST_FAIL("Cost raster pixel %d is wrong.\n", i);
+
+  double cost = findPath(raster, costWeight, path);
+  if (fabs(cost - expected) >= 10e-4)
+    TEST_FAIL("Cost raster cost (%f) did not match findPath (%f).\n", cost,
+              expected);
+
+  free(costs);
+  free(path);
+  freeImage(raster);
+  freeImage(img);
+}
+
+TEST(cost_raster) { run_cost_raster_test(NULL); }
+TEST(cost_raster_pfm) { run_cost_raster_test("-1.0"); }
+TEST(cost_raster_pfm_big_endian) { run_cost_raster_test("1.0"); }
+
+void run_isochrone_test(char *filename, WeightFunc wf, double budget)
+{
+  Image *img = readPPMimage(filename);
+  int n = img->sx * img->sy;
+  int source = img->sx / 2 + (img->sy / 2) * img->sx;
+
+  // Every pixel's cost, from a search that reaches all of them
+  int *all = malloc(sizeof(int) * n);
+  double *costs = malloc(sizeof(double) * n);
+  for (int i = 0; i < n; i++)
+    all[i] = i;
+  SearchWorkspace *ws = newWorkspace(n);
+  searchWorkspaceAll(ws, img, wf, source, all, n, costs);
+  freeWorkspace(ws);
+
+  Isochrone *iso = findReachable(img, wf, source, budget, 1);
+  int expected = 0;
+  for (int i = 0; i < n; i++)
+  {
+    int x = i % img->sx, y = i / img->sx;
+    int reached = costs[i] <= budget;
+    expected += reached;
+    if (isochroneReached(iso, x, y) != reached)
+      TEST_FAIL("Pixel (%d, %d) at cost %f is wrongly %s.\n", x, y, costs[i],
+                reached ? "not reached" : "reached");
+    if (isochroneDistance(iso, x, y) != (reached ? costs[i] : INFINITY))
+      TEST_FAIL("Isochrone cost of (%d, %d) is wrong.\n", x, y);
+  }
+  if (iso->numReached != expected)
+    TEST_FAIL("Isochrone reached %d pixels, expected %d.\n", iso->numReached,
+              expected);
+
+  freeIsochrone(iso);
+  free(costs);
+  free(all);
+  freeImage(img);
+}
+
+TEST(isochrone_small) { run_isochrone_test("images/water.ppm", similarColour, 50.0); }
+TEST(isochrone_large) { run_isochrone_test("images/water.ppm", similarColour, 500.0); }
+TEST(isochrone_maze) { run_isochrone_test("images/maze.ppm", howWhite, 3.0); }
+TEST(isochrone_everything) { run_isochrone_test("images/spiral.ppm", similarColour, 1e9); }
+
+TEST(isochrone_diagonal)
+{
+  // A one pixel wide staircase from corner to corner: the box around it is
+  // the whole image, but the distances are kept per pixel reached
+  int size = 500;
+  Image *img = newImage(size, size);
+  for (int i = 0; i < 2 * size - 1; i++)
+  {
+    int x = (i + 1) / 2, y = i / 2;
+    img->data[x + y * size].R = 255;
+    img->data[x + y * size].G = img->data[x + y * size].B = 255;
+  }
+  Isochrone *iso = findReachable(img, howWhite, 0, 10.0, 1);
+  if (iso->sx != size || iso->sy != size || iso->numReached != 2 * size - 1)
+    TEST_FAIL("Staircase isochrone is %dx%d with %d pixels.\n", iso->sx,
+              iso->sy, iso->numReached);
+  for (int i = 0; i < 2 * size - 1; i++)
+  {
+    int x = (i + 1) / 2, y = i / 2;
+    if (iso->boxIndex[i] != x + y * size ||
+        fabs(isochroneDistance(iso, x, y) - 0.01 * i) >= 10e-6)
+      TEST_FAIL("Staircase pixel %d is wrong.\n", i);
+  }
+  if (isochroneDistance(iso, 0, 1) != INFINITY)
+    TEST_FAIL("Pixel off the staircase has a distance.\n");
+  freeIsochrone(iso);
+  freeImage(img);
+}
+
+/****************************** Benchmarks ***********************************/
+
+// Call the weight function `bench_n` times, stepping right across water.ppm
+void bench_weight(long n, WeightFunc wf)
+{
+  Image *img = readPPMimage("images/water.ppm");
+  int last = img->sx * img->sy - 1;
+  volatile double sink = 0.0;
+  BENCH_RESET_TIMER();
+  for (long i = 0, a = 0; i < n; i++, a = a + 1 < last ? a + 1 : 0)
+    sink += wf(img, a, a + 1);
+  BENCH_STOP_TIMER();
+  freeImage(img);
+}
+
+BENCH(similar_colour) { bench_weight(bench_n, similarColour); }
+BENCH(how_white) { bench_weight(bench_n, howWhite); }
+BENCH(all_colour_weight) { bench_weight(bench_n, allColourWeight); }
+
+// findPath() on bigmaze.ppm, per pixel of the image
+void bench_bigmaze(long n, int usePalette)
+{
+  Image *img = readPPMimage("images/bigmaze.ppm");
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  WeightFunc wf = howWhite;
+  if (usePalette && buildPalette(img, 256) > 0)
+  {
+    buildPaletteWeights(img, howWhite);
+    wf = paletteWeight;
+  }
+  BENCH_RESET_TIMER();
+  for (long done = 0; done < n; done += img->sx * img->sy)
+    findPath(img, wf, path);
+  BENCH_STOP_TIMER();
+  free(path);
+  freeImage(img);
+}
+
+BENCH(bigmaze_rgb) { bench_bigmaze(bench_n, 0); }
+BENCH(bigmaze_palette) { bench_bigmaze(bench_n, 1); }
+
+// findPathRegions() on bigmaze.ppm, per pixel of the image
+BENCH(bigmaze_regions)
+{
+  Image *img = readPPMimage("images/bigmaze.ppm");
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  RegionMap *map = findUniformRegions(img);
+  BENCH_RESET_TIMER();
+  for (long done = 0; done < bench_n; done += img->sx * img->sy)
+    findPathRegions(img, howWhite, map, path);
+  BENCH_STOP_TIMER();
+  freeRegionMap(map);
+  free(path);
+  freeImage(img);
+}
+
+// Query throughput on a large random image, per query, with a pool that
+// has already seen the image
+void bench_queries(long n, int numThreads)
+{
+  Image *img = newImage(2000, 2000);
+  srand(3);
+  for (int i = 0; i < img->sx * img->sy; i++)
+    img->data[i].R = rand(), img->data[i].G = rand(), img->data[i].B = rand();
+  PathQuery *queries = random_queries(img, n, 20);
+  QueryPool *pool = newQueryPool(numThreads);
+  int warmup = n < numThreads ? n : numThreads;
+  runQueriesPool(pool, img, similarColour, queries, warmup);
+  BENCH_RESET_TIMER();
+  runQueriesPool(pool, img, similarColour, queries, n);
+  BENCH_STOP_TIMER();
+  freeQueryPool(pool);
+  free(queries);
+  freeImage(img);
+}
+
+BENCH(queries_1_thread) { bench_queries(bench_n, 1); }
+BENCH(queries_2_threads) { bench_queries(bench_n, 2); }
+BENCH(queries_4_threads) { bench_queries(bench_n, 4); }
+
+// The similarColour expression, evaluated in batches like buildWeightGrid()
+BENCH(expr_similar_colour)
+{
+  Image *img = readPPMimage("images/water.ppm");
+  WeightExpr *expr = compileWeightExpr(
+      "sqrt((r1-r2)^2 + (g1-g2)^2 + (b1-b2)^2) + 0.01", NULL, 0);
+  int run = img->sx * img->sy - 1;
+  double *out = malloc(sizeof(double) * run);
+  BENCH_RESET_TIMER();
+  for (long done = 0; done < bench_n; done += run)
+  {
+    int n = bench_n - done < run ? bench_n - done : run;
+    weightExprEval(expr, img, 0, 1, n, out);
+  }
+  BENCH_STOP_TIMER();
+  free(out);
+  freeWeightExpr(expr);
+  freeImage(img);
+}
+
+// Filling a whole weight grid from the expression, per step in the grid
+BENCH(expr_weight_grid)
+{
+  Image *img = readPPMimage("images/water.ppm");
+  WeightExpr *expr = compileWeightExpr(
+      "sqrt((r1-r2)^2 + (g1-g2)^2 + (b1-b2)^2) + 0.01", NULL, 0);
+  long steps = 4L * img->sx * img->sy;
+  BENCH_RESET_TIMER();
+  for (long done = 0; done < bench_n; done += steps)
+    buildWeightGrid(img, expr);
+  BENCH_STOP_TIMER();
+  freeWeightExpr(expr);
+  freeImage(img);
+}
+
+// Building 8 landmarks for water.ppm, per pixel of the image
+BENCH(landmarks_build)
+{
+  Image *img = readPPMimage("images/water.ppm");
+  BENCH_RESET_TIMER();
+  for (long done = 0; done < bench_n; done += img->sx * img->sy)
+    freeLandmarks(buildLandmarks(img, similarColour, 8, 1));
+  BENCH_STOP_TIMER();
+  freeImage(img);
+}
+
+// Random long queries on water.ppm, per query, with and without landmarks
+// (both reusing one workspace, so only the search itself is timed)
+void bench_water_queries(long n, int useLandmarks)
+{
+  Image *img = readPPMimage("images/water.ppm");
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  Landmarks *lm = useLandmarks ? buildLandmarks(img, similarColour, 8, 1)
+                               : NULL;
+  SearchWorkspace *ws = newWorkspace(img->sx * img->sy);
+  PathQuery *queries = random_queries(img, n, img->sx);
+  BENCH_RESET_TIMER();
+  for (long i = 0; i < n; i++)
+  {
+    int s = queries[i].source, t = queries[i].target;
+    if (lm)
+      findPathLandmarks(ws, img, similarColour, lm, s, t, path);
+    else
+      findPathMultiWorkspace(ws, img, similarColour, &s, NULL, 1, &t, 1, path,
+                             NULL, NULL);
+  }
+  BENCH_STOP_TIMER();
+  freeWorkspace(ws);
+  freeLandmarks(lm);
+  free(queries);
+  free(path);
+  freeImage(img);
+}
+
+BENCH(water_queries_dijkstra) { bench_water_queries(bench_n, 0); }
+BENCH(water_queries_landmarks) { bench_water_queries(bench_n, 1); }
+
+// findPath() against findPathSweep(), per pixel of the image
+void bench_sweep(long n, char *filename, int useSweep)
+{
+  Image *img = readPPMimage(filename);
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  BENCH_RESET_TIMER();
+  for (long done = 0; done < n; done += img->sx * img->sy)
+  {
+    if (useSweep)
+      findPathSweep(img, similarColour, path, 1);
+    else
+      findPath(img, similarColour, path);
+  }
+  BENCH_STOP_TIMER();
+  free(path);
+  freeImage(img);
+}
+
+BENCH(grad_dijkstra) { bench_sweep(bench_n, "images/grad.ppm", 0); }
+BENCH(grad_sweep) { bench_sweep(bench_n, "images/grad.ppm", 1); }
+BENCH(water_dijkstra) { bench_sweep(bench_n, "images/water.ppm", 0); }
+BENCH(water_sweep) { bench_sweep(bench_n, "images/water.ppm", 1); }
+BENCH(spiral_dijkstra) { bench_sweep(bench_n, "images/spiral.ppm", 0); }
+BENCH(spiral_sweep) { bench_sweep(bench_n, "images/spiral.ppm", 1); }
+
+// findPath() against findPathTurns(), per pixel of the image
+void bench_turns(long n, char *filename, WeightFunc wf, int useTurns)
+{
+  Image *img = readPPMimage(filename);
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  BENCH_RESET_TIMER();
+  for (long done = 0; done < n; done += img->sx * img->sy)
+  {
+    if (useTurns)
+      findPathTurns(img, wf, 10.0, path);
+    else
+      findPath(img, wf, path);
+  }
+  BENCH_STOP_TIMER();
+  free(path);
+  freeImage(img);
+}
+
+BENCH(bigmaze_turns) { bench_turns(bench_n, "images/bigmaze.ppm", howWhite, 1); }
+BENCH(water_turns) { bench_turns(bench_n, "images/water.ppm", similarColour, 1); }
+
+// The whole 25x25 matrix for 25colours.ppm, per row
+void bench_matrix(long n, int useMatrix)
+{
+  Image *img = readPPMimage("images/25colours.ppm");
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  int k;
+  int *points = palette_points(img, &k);
+  BENCH_RESET_TIMER();
+  for (long done = 0; done < n; done += k)
+  {
+    if (useMatrix)
+      free(distanceMatrix(img, similarColour, points, k, 1));
+    else
+      for (int i = 0; i < k * k; i++)
+        findPathMulti(img, similarColour, &points[i / k], NULL, 1,
+                      &points[i % k], 1, path, NULL, NULL);
+  }
+  BENCH_STOP_TIMER();
+  free(points);
+  free(path);
+  freeImage(img);
+}
+
+BENCH(matrix_pairwise) { bench_matrix(bench_n, 0); }
+BENCH(matrix_one_to_many) { bench_matrix(bench_n, 1); }
+
+// A small isochrone on images of increasing size, per query: the time
+// should not depend on the image
+void bench_isochrone(long n, int size)
+{
+  Image *img = newImage(size, size);
+  for (int i = 0; i < size * size; i++)
+    img->data[i].R = img->data[i].G = img->data[i].B = 255;
+  int source = size / 2 + (size / 2) * size;
+  BENCH_RESET_TIMER();
+  for (long i = 0; i < n; i++)
+    freeIsochrone(findReachable(img, howWhite, source, 0.5, 0));
+  BENCH_STOP_TIMER();
+  freeImage(img);
+}
+
+BENCH(isochrone_200) { bench_isochrone(bench_n, 200); }
+BENCH(isochrone_4000) { bench_isochrone(bench_n, 4000); }
+
+// findPath() with upward steps forbidden against findMonotonePath(), per
+// pixel of the image
+void bench_monotone(long n, char *filename, int useMonotone)
+{
+  Image *img = readPPMimage(filename);
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  BENCH_RESET_TIMER();
+  for (long done = 0; done < n; done += img->sx * img->sy)
+  {
+    if (useMonotone)
+      findMonotonePath(img, similarColour, path, 1);
+    else
+      findPath(img, downSimilarColour, path);
+  }
+  BENCH_STOP_TIMER();
+  free(path);
+  freeImage(img);
+}
+
+BENCH(water_down_dijkstra) { bench_monotone(bench_n, "images/water.ppm", 0); }
+BENCH(water_monotone) { bench_monotone(bench_n, "images/water.ppm", 1); }
+BENCH(bigmaze_down_dijkstra) { bench_monotone(bench_n, "images/bigmaze.ppm", 0); }
+BENCH(bigmaze_monotone) { bench_monotone(bench_n, "images/bigmaze.ppm", 1); }
+
+// Short queries on a large random image, per query, each either starting
+// from scratch (findPathMulti()) or reusing one workspace
+void bench_workspace(long n, int reuse)
+{
+  Image *img = newImage(2000, 2000);
+  srand(3);
+  for (int i = 0; i < img->sx * img->sy; i++)
+    img->data[i].R = rand(), img->data[i].G = rand(), img->data[i].B = rand();
+  int *path = calloc(sizeof(int), img->sx * img->sy + 1);
+  PathQuery *queries = random_queries(img, n, 10);
+  SearchWorkspace *ws = newWorkspace(img->sx * img->sy);
+  BENCH_RESET_TIMER();
+  for (long i = 0; i < n; i++)
+  {
+    int s = queries[i].source, t = queries[i].target;
+    if (reuse)
+      searchWorkspace(ws, img, similarColour, &s, NULL, 1, &t, 1, NULL, NULL);
+    else
+      findPathMulti(img, similarColour, &s, NULL, 1, &t, 1, path, NULL,
+                    NULL);
+  }
+  BENCH_STOP_TIMER();
+  freeWorkspace(ws);
+  free(queries);
+  free(path);
+  freeImage(img);
+}
+
+BENCH(queries_fresh) { bench_workspace(bench_n, 0); }
+BENCH(queries_reused_workspace) { bench_workspace(bench_n, 1); }
+
+// Writing a path overlay for a 6000x6000 image (to Path-bench.ppm), per
+// image written, with the path along the top and right edges
+BENCH(output_path)
+{
+  int sx = 6000, sy = 6000;
+  Image *img = newImage(sx, sy);
+  img->filename = "bench.ppm";
+  int *path = malloc(sizeof(int) * (sx + sy));
+  int n = 0;
+  for (int x = 0; x < sx; x++)
+    path[n++] = x;
+  for (int y = 1; y < sy; y++)
+    path[n++] = y * sx + sx - 1;
+  path[n] = -1;
+  BENCH_RESET_TIMER();
+  for (long i = 0; i < bench_n; i++)
+    outputPath(path, img);
+  BENCH_STOP_TIMER();
+  free(path);
+  freeImage(img);
+}
+
+// findPath() against findPathTiled() on a random 64-level grey image of
+// 1M pixels, per search (tiling the image is not timed)
+void bench_tiled(long n, int sx, int sy, int useTiles)
+{
+  Image *img = newImage(sx, sy);
+  srand(11);
+  for (int i = 0; i < sx * sy; i++)
+    img->data[i].R = img->data[i].G = img->data[i].B = (rand() % 64) * 4;
+  Image *tiled = tileImage(img);
+  int *path = calloc(sizeof(int), sx * sy + 1);
+  BENCH_RESET_TIMER();
+  for (long i = 0; i < n; i++)
+  {
+    if (useTiles)
+      findPathTiled(tiled, similarColour, path);
+    else
+      findPath(img, similarColour, path);
+  }
+  BENCH_STOP_TIMER();
+  free(path);
+  freeImage(tiled);
+  freeImage(img);
+}
+
+BENCH(wide_row_major) { bench_tiled(bench_n, 4000, 250, 0); }
+BENCH(wide_tiled) { bench_tiled(bench_n, 4000, 250, 1); }
+BENCH(tall_row_major) { bench_tiled(bench_n, 250, 4000, 0); }
+BENCH(tall_tiled) { bench_tiled(bench_n, 250, 4000, 1); }
+
 int main(int argc, char *argv[])
 {
   unit_main(argc, argv);
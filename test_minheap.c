@@ -142,6 +142,204 @@ TEST(decrease_priorities_1)
       TEST_FAIL("Decrease Priority didn't assign priorities correctly.\n");
 }
 
+// Extract everything and check that it comes out in sorted order
+static int drainsSorted(MinHeap *heap, int expectedCount)
+{
+  double pri, last = -INFINITY;
+  int count = 0;
+  while (heap->numItems > 0)
+  {
+    heapExtractMin(heap, &pri);
+    if (pri < last)
+      return 0;
+    last = pri;
+    count++;
+  }
+  return count == expectedCount;
+}
+
+TEST(heap_build)
+{
+  int vals[1000];
+  double pr[1000];
+  srand(1);
+  for (int i = 0; i < 1000; i++)
+    vals[i] = 999 - i, pr[i] = rand() % 500;
+
+  MinHeap *heap = newMinHeap(1000);
+  heapPush(heap, 5, -1.0); // Should be discarded by heapBuild()
+  heapBuild(heap, vals, pr, 1000);
+  if (heap->numItems != 1000 || !checkHeap(heap))
+    TEST_FAIL("Failed checkHeap() after heapBuild()\n");
+  if (!drainsSorted(heap, 1000))
+    TEST_FAIL("heapBuild() heap did not extract in order\n");
+  freeHeap(heap);
+}
+
+TEST(push_batch)
+{
+  MinHeap *heap = newMinHeap(1000);
+  int vals[1000];
+  double pr[1000];
+  for (int i = 0; i < 1000; i++)
+    vals[i] = i, pr[i] = (i * 7919) % 1000;
+
+  // A small batch (pushed one at a time) and a large one (rebuilt)
+  heapPushBatch(heap, vals, pr, 3);
+  heapPushBatch(heap, vals + 3, pr + 3, 997);
+  if (!checkHeap(heap))
+    TEST_FAIL("Failed checkHeap() after heapPushBatch()\n");
+
+  double pri;
+  for (int i = 0; i < 1000; i++)
+  {
+    int v = heapExtractMin(heap, &pri);
+    if (pri != i || (v * 7919) % 1000 != i)
+      TEST_FAIL("heapPushBatch() did not store priorities correctly.\n");
+  }
+  freeHeap(heap);
+}
+
+TEST(decrease_priorities_batch)
+{
+  MinHeap *heap = newMinHeap(100);
+  int vals[100];
+  double pr[100];
+  for (int i = 0; i < 100; i++)
+    heapPush(heap, i, 100000.0);
+
+  // A small batch first, then everything in one go
+  for (int i = 0; i < 100; i++)
+    vals[i] = i, pr[i] = 99 - i;
+  heapDecreasePriorityBatch(heap, vals + 90, pr + 90, 2);
+  if (!checkHeap(heap))
+    TEST_FAIL("Failed checkHeap() after small batch\n");
+  heapDecreasePriorityBatch(heap, vals, pr, 100);
+  if (!checkHeap(heap))
+    TEST_FAIL("Failed checkHeap() after large batch\n");
+
+  double pri;
+  for (int i = 0; i < 100; i++)
+    if (heapExtractMin(heap, &pri) != 99 - i || pri != i)
+      TEST_FAIL("Batch decrease didn't assign priorities correctly.\n");
+  freeHeap(heap);
+}
+
+TEST(resize)
+{
+  MinHeap *heap = newMinHeap(4);
+  double pri;
+  for (int i = 0; i < 4; i++)
+    heapPush(heap, i, 100 - i);
+
+  // Values and items past the old size, with the old ones still there
+  heapResize(heap, 1000);
+  heapResize(heap, 10); // Never shrinks
+  for (int i = 4; i < 1000; i++)
+    heapPush(heap, i, 100 - i);
+  heapDecreasePriority(heap, 0, -1000);
+  if (heap->maxSize != 1000 || !checkHeap(heap))
+    TEST_FAIL("Failed checkHeap() after heapResize()\n");
+
+  if (heapExtractMin(heap, &pri) != 0 || pri != -1000)
+    TEST_FAIL("heapResize() lost an old value\n");
+  for (int i = 999; i >= 1; i--)
+    if (heapExtractMin(heap, &pri) != i || pri != 100 - i)
+      TEST_FAIL("heapResize() heap did not extract in order\n");
+  freeHeap(heap);
+}
+
+/****************************** Benchmarks ***********************************/
+
+// Fill `pr` with pseudo-random priorities in [0, size)
+static double *randomPriorities(int size)
+{
+  double *pr = malloc(sizeof(double) * size);
+  srand(42);
+  for (int i = 0; i < size; i++)
+    pr[i] = rand() % size;
+  return pr;
+}
+
+// Empty the heap without timing it
+static void clearHeap(MinHeap *heap)
+{
+  for (int i = 0; i < heap->numItems; i++)
+    heap->indices[heap->arr[i].val] = -1;
+  heap->numItems = 0;
+}
+
+// heapPush: fill a heap of `size` elements over and over
+static void benchPush(long n, int size)
+{
+  MinHeap *heap = newMinHeap(size);
+  double *pr = randomPriorities(size);
+  BENCH_RESET_TIMER();
+  for (long done = 0; done < n;)
+  {
+    for (int i = 0; i < size && done < n; i++, done++)
+      heapPush(heap, i, pr[i]);
+    BENCH_STOP_TIMER();
+    clearHeap(heap);
+    BENCH_START_TIMER();
+  }
+  BENCH_STOP_TIMER();
+  free(pr);
+  freeHeap(heap);
+}
+
+// heapExtractMin: drain a full heap of `size` elements over and over
+static void benchExtractMin(long n, int size)
+{
+  MinHeap *heap = newMinHeap(size);
+  double *pr = randomPriorities(size);
+  double pri;
+  BENCH_RESET_TIMER();
+  BENCH_STOP_TIMER();
+  for (long done = 0; done < n;)
+  {
+    clearHeap(heap);
+    for (int i = 0; i < size; i++)
+      heapPush(heap, i, pr[i]);
+    BENCH_START_TIMER();
+    for (int i = 0; i < size && done < n; i++, done++)
+      heapExtractMin(heap, &pri);
+    BENCH_STOP_TIMER();
+  }
+  free(pr);
+  freeHeap(heap);
+}
+
+// heapDecreasePriority: lower every element of a heap of `size` elements
+static void benchDecreasePriority(long n, int size)
+{
+  MinHeap *heap = newMinHeap(size);
+  double *pr = randomPriorities(size);
+  BENCH_RESET_TIMER();
+  BENCH_STOP_TIMER();
+  for (long done = 0; done < n;)
+  {
+    clearHeap(heap);
+    for (int i = 0; i < size; i++)
+      heapPush(heap, i, size + pr[i]);
+    BENCH_START_TIMER();
+    for (int i = 0; i < size && done < n; i++, done++)
+      heapDecreasePriority(heap, i, pr[i]);
+    BENCH_STOP_TIMER();
+  }
+  free(pr);
+  freeHeap(heap);
+}
+
+#define HEAP_BENCHES(size)                                                \
+  BENCH(push_##size) { benchPush(bench_n, size); }                        \
+  BENCH(extract_min_##size) { benchExtractMin(bench_n, size); }           \
+  BENCH(decrease_priority_##size) { benchDecreasePriority(bench_n, size); }
+
+HEAP_BENCHES(1024)
+HEAP_BENCHES(65536)
+HEAP_BENCHES(1048576)
+
 int main(int argc, char *argv[])
 {
   unit_main(argc, argv);
@@ -0,0 +1,177 @@
+#include "tiled.h"
+
+/**
+ * Blocked pixel layout.
+ *
+ * In the usual row-major layout, the pixels above and below a pixel are
+ * `sx` entries away, so on wide images every vertical step of the search
+ * touches a different cache line (in the image and in each of the search's
+ * per-pixel arrays). Here the image is cut into 16x16 tiles, and each tile
+ * is stored contiguously (row-major within the tile, tiles in row-major
+ * order), so most vertical neighbours are only 16 entries away:
+ *
+ *    index(x, y) = ((y / 16) * tilesX + (x / 16)) * 256
+ *                  + (y % 16) * 16 + (x % 16)
+ *
+ * The image is padded to a whole number of tiles. Padding pixels are never
+ * visited by the search.
+ *
+ * A tiled image is still an `Image`, with the same `sx` and `sy`, but its
+ * pixel indices are tiled indices. So it works with weight functions that
+ * only look at the colours of the pixels they are given (like similarColour()
+ * and howWhite()), but not with ones that depend on where the pixels are
+ * (like allColourWeight(), gridWeight() or paletteWeight()).
+ */
+
+static inline int tilesAcross(Image *im)
+{
+  return (im->sx + TILE_SIZE - 1) >> TILE_BITS;
+}
+
+/**
+ * Index of pixel (x, y) in the tiled layout of an image of this size.
+ */
+int tiledIndex(Image *im, int x, int y)
+{
+  int tile = (y >> TILE_BITS) * tilesAcross(im) + (x >> TILE_BITS);
+  return (tile << (2 * TILE_BITS)) | ((y & (TILE_SIZE - 1)) << TILE_BITS) |
+         (x & (TILE_SIZE - 1));
+}
+
+/**
+ * Make a copy of the image with its pixels in the tiled layout.
+ */
+Image *tileImage(Image *im)
+{
+  int tilesX = tilesAcross(im);
+  int tilesY = (im->sy + TILE_SIZE - 1) >> TILE_BITS;
+
+  Image *tiled = newImage(tilesX * TILE_SIZE, tilesY * TILE_SIZE);
+  if (tiled == NULL)
+    return NULL;
+  tiled->sx = im->sx;
+  tiled->sy = im->sy;
+  tiled->filename = im->filename;
+
+  for (int y = 0; y < im->sy; y++)
+    for (int x = 0; x < im->sx; x++)
+      tiled->data[tiledIndex(im, x, y)] = im->data[x + y * im->sx];
+  return tiled;
+}
+
+/**
+ * findPath() on an image made by tileImage(). All of the search's
+ * per-pixel state uses the tiled layout too. The path is converted back to
+ * row-major pixel indices at the end, so `path` can be used with the
+ * original image (e.g. for outputPath()).
+ */
+double findPathTiled(Image *tiled, WeightFunc weight, int path[])
+{
+  int sx = tiled->sx, sy = tiled->sy;
+  int tilesX = tilesAcross(tiled);
+  int numSlots = tilesX * ((sy + TILE_SIZE - 1) >> TILE_BITS) * TILE_SIZE *
+                 TILE_SIZE;
+  int mask = TILE_SIZE - 1;
+
+  // Steps between neighbours, within a tile and across into the next one
+  int rowStep = TILE_SIZE;
+  int tileStep = TILE_SIZE * TILE_SIZE;
+  int tileRowStep = tilesX * tileStep;
+
+  path[0] = -1;
+
+  MinHeap *heap = newMinHeap(numSlots);
+  double *dist = malloc(sizeof(double) * numSlots);
+  int *parent = malloc(sizeof(int) * numSlots);
+  if (dist == NULL || parent == NULL)
+  {
+    fprintf(stderr, "findPathTiled(): Out of memory.\n");
+    exit(1);
+  }
+  for (int i = 0; i < numSlots; i++)
+    dist[i] = INFINITY;
+
+  int source = tiledIndex(tiled, 0, 0);
+  int target = tiledIndex(tiled, sx - 1, sy - 1);
+  dist[source] = 0.0;
+  parent[source] = -1;
+  heapPush(heap, source, 0.0);
+
+  double priority;
+  int found = 0;
+  while (heap->numItems != 0)
+  {
+    int p = heapExtractMin(heap, &priority);
+    if (p == target)
+    {
+      found = 1;
+      break;
+    }
+
+    // Recover (x, y) from the tiled index
+    int tile = p >> (2 * TILE_BITS);
+    int x = ((tile % tilesX) << TILE_BITS) | (p & mask);
+    int y = ((tile / tilesX) << TILE_BITS) | ((p >> TILE_BITS) & mask);
+
+    int neighbours[4], count = 0;
+    if (x > 0)
+      neighbours[count++] = (x & mask) ? p - 1 : p - tileStep + mask;
+    if (y > 0)
+      neighbours[count++] =
+          (y & mask) ? p - rowStep : p - tileRowStep + mask * rowStep;
+    if (x < sx - 1)
+      neighbours[count++] = (x & mask) != mask ? p + 1 : p + tileStep - mask;
+    if (y < sy - 1)
+      neighbours[count++] = (y & mask) != mask
+                                ? p + rowStep
+                                : p + tileRowStep - mask * rowStep;
+
+    for (int i = 0; i < count; i++)
+    {
+      int q = neighbours[i];
+      double total = priority + weight(tiled, p, q);
+      if (dist[q] == INFINITY)
+      {
+        if (total < INFINITY)
+        {
+          dist[q] = total;
+          parent[q] = p;
+          heapPush(heap, q, total);
+        }
+      }
+      else if (heap->indices[q] != -1 && total < dist[q])
+      {
+        dist[q] = total;
+        parent[q] = p;
+        heapDecreasePriority(heap, q, total);
+      }
+    }
+  }
+
+  double pathWeight = INFINITY;
+  if (found)
+  {
+    pathWeight = priority;
+
+    int n = 0;
+    for (int p = target; p != -1; p = parent[p])
+      n++;
+
+    // Fill the path from the end, converting back to row-major indices
+    path[n] = -1;
+    int p = target;
+    for (int i = n - 1; i >= 0; i--, p = parent[p])
+    {
+      int tile = p >> (2 * TILE_BITS);
+      int x = ((tile % tilesX) << TILE_BITS) | (p & mask);
+      int y = ((tile / tilesX) << TILE_BITS) | ((p >> TILE_BITS) & mask);
+      path[i] = x + y * sx;
+    }
+  }
+
+  free(parent);
+  free(dist);
+  freeHeap(heap);
+
+  return pathWeight;
+}
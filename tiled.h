@@ -0,0 +1,14 @@
+#ifndef __TILED_H__
+#define __TILED_H__
+
+#include "marcher.h"
+
+// Tiles are TILE_SIZE x TILE_SIZE pixels (TILE_SIZE = 1 << TILE_BITS)
+#define TILE_BITS 4
+#define TILE_SIZE (1 << TILE_BITS)
+
+int tiledIndex(Image *im, int x, int y);
+Image *tileImage(Image *im);
+double findPathTiled(Image *tiled, WeightFunc weight, int path[]);
+
+#endif // __TILED_H__
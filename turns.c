@@ -0,0 +1,129 @@
+#include "turns.h"
+#include "chaincode.h"
+#include "lazyheap.h"
+
+/**
+ * Least-energy paths where changing direction costs extra.
+ *
+ * The cost of a step now depends on the step before it, so the search
+ * state is (pixel, direction the pixel was entered in) rather than just the
+ * pixel: 4 states per pixel, numbered 4 * pixel + direction (CHAIN_RIGHT,
+ * CHAIN_DOWN, ... from chaincode.h) so that the states of a pixel sit next
+ * to each other in memory. Per pixel this keeps:
+ *
+ *    - 4 distances (double)                         32 bytes / pixel
+ *    - 4 parent directions, 2 bits each              1 byte  / pixel
+ *    - heap entries (double, int) for frontier only 16 bytes / entry
+ *
+ * A state's parent is known from its own direction except for the direction
+ * the parent was entered in, so 2 bits are enough. The heap and the 2-bit
+ * packing are the ones compact.c uses (lazyheap.h): there is no heap index
+ * array, improved states are pushed again, and stale entries are skipped
+ * when they come out.
+ */
+
+DEFINE_LAZY_HEAP(TurnHeap, TurnEntry, turn, double, "findPathTurns")
+
+/**
+ * Least-energy path from pixel (0,0) to pixel (sx-1, sy-1), like findPath(),
+ * except that every 90 degree turn along the path adds `turnCost`. The
+ * first step is free to go either way. Returns the total cost including the
+ * turns, or INFINITY (with path[0] = -1) if the end cannot be reached.
+ */
+double findPathTurns(Image *im, WeightFunc weight, double turnCost,
+                     int path[])
+{
+  int sx = im->sx, sy = im->sy;
+  int numPixels = sx * sy;
+  int target = numPixels - 1;
+  int step[4];
+  step[CHAIN_RIGHT] = 1;
+  step[CHAIN_DOWN] = sx;
+  step[CHAIN_LEFT] = -1;
+  step[CHAIN_UP] = -sx;
+
+  path[0] = -1;
+
+  double *dist = malloc(sizeof(double) * 4 * numPixels);
+  uint8_t *parents = calloc(1, numPixels);
+  TurnHeap heap = {0, 1024, malloc(sizeof(TurnEntry) * 1024)};
+  if (dist == NULL || parents == NULL || heap.arr == NULL)
+  {
+    fprintf(stderr, "findPathTurns(): Out of memory.\n");
+    exit(1);
+  }
+
+  for (int i = 0; i < 4 * numPixels; i++)
+    dist[i] = INFINITY;
+  for (int d = 0; d < 4; d++)
+  {
+    dist[d] = 0.0;
+    turnPush(&heap, d, 0.0);
+  }
+
+  int found = -1;
+  while (heap.numItems != 0)
+  {
+    TurnEntry e = turnExtractMin(&heap);
+    if (e.priority != dist[e.val])
+      continue; // Stale entry
+
+    int p = e.val >> 2, in = e.val & 3;
+    if (p == target)
+    {
+      found = e.val;
+      break;
+    }
+
+    int x = p % sx, y = p / sx;
+    for (int out = 0; out < 4; out++)
+    {
+      // Going straight back to the previous pixel never pays off, since
+      // turning there instead would have cost no more
+      if (out == ((in + 2) & 3) && p != 0)
+        continue;
+      if ((out == CHAIN_RIGHT && x == sx - 1) ||
+          (out == CHAIN_LEFT && x == 0) ||
+          (out == CHAIN_DOWN && y == sy - 1) ||
+          (out == CHAIN_UP && y == 0))
+        continue;
+
+      int q = p + step[out];
+      double total = e.priority + weight(im, p, q) +
+                     (out == in ? 0.0 : turnCost);
+      int s = 4 * q + out;
+      if (total < dist[s])
+      {
+        dist[s] = total;
+        setPackedCode(parents, s, in);
+        turnPush(&heap, s, total);
+      }
+    }
+  }
+
+  double pathWeight = INFINITY;
+  if (found != -1)
+  {
+    pathWeight = dist[found];
+
+    // Count the steps back to (0,0), then fill the path from its end
+    int n = 0;
+    for (int s = found; s >> 2 != 0; n++)
+      s = 4 * ((s >> 2) - step[s & 3]) + getPackedCode(parents, s);
+
+    path[n + 1] = -1;
+    int s = found;
+    for (int i = n; i >= 0; i--)
+    {
+      path[i] = s >> 2;
+      if (i > 0)
+        s = 4 * ((s >> 2) - step[s & 3]) + getPackedCode(parents, s);
+    }
+  }
+
+  free(heap.arr);
+  free(parents);
+  free(dist);
+
+  return pathWeight;
+}
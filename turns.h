@@ -0,0 +1,9 @@
+#ifndef __TURNS_H__
+#define __TURNS_H__
+
+#include "marcher.h"
+
+double findPathTurns(Image *im, WeightFunc weight, double turnCost,
+                     int path[]);
+
+#endif // __TURNS_H__
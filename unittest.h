@@ -9,17 +9,47 @@
  *      - In the main function, call `unit_main(argc, argv)` to run tests.
  *
  *      - Run `./program test_name` to run a single test or `./program`
- *          to run all tests. The latter is not ideal as no further tests
- *          are fun as soon as a single one fails.
+ *          to run all tests. A failing test is reported and the remaining
+ *          tests still run; the program exits with status 1 at the end if
+ *          anything failed.
+ *
+ *      - Every test is timed. The following options can come before the
+ *          test name:
+ *
+ *            --repeat N           Run each test N times, report median/min
+ *            --budget MS          Fail tests whose median exceeds MS
+ *                                 milliseconds (default 2000). Single
+ *                                 tests can override it with TEST_BUDGET().
+ *            --baseline FILE      Fail tests whose median is slower than
+ *                                 the one recorded in FILE by more than the
+ *                                 threshold
+ *            --threshold X        Allowed slowdown factor (default 1.5)
+ *            --slack MS           Extra milliseconds always allowed on top
+ *                                 of the threshold, to absorb noise in very
+ *                                 short tests (default 5)
+ *            --save-baseline FILE Write the medians of this run to FILE
+ *
+ *          Baseline files have one `test_name median_ms` pair per line.
+ *
+ *      - Benchmarks are declared with BENCH(name) and run with
+ *          `./program --bench` (all of them) or `./program --bench name`.
+ *          The body gets the number of operations to perform in `bench_n`,
+ *          and can leave setup out of the timing with BENCH_RESET_TIMER(),
+ *          BENCH_STOP_TIMER() and BENCH_START_TIMER(). Each benchmark is
+ *          warmed up, its `bench_n` is grown until one run takes at least
+ *          50 ms, and then it is run --repeat times (default 5) and the
+ *          median/min ns/op and ops/sec are reported.
  *
  *  ------------------------------------------------------------------------
  */
 #pragma once
 
+#include <setjmp.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /* Main test case container */
 typedef struct unit_test
@@ -29,6 +59,14 @@ typedef struct unit_test
   struct unit_test *next;  // Next pointer for internal linked list
 } unit_test;
 
+/* Benchmark container */
+typedef struct unit_bench
+{
+  char *name;               // User-defined name of benchmark
+  void (*bench_func)(long); // Runs the benchmark for `bench_n` ops
+  struct unit_bench *next;  // Next pointer for internal linked list
+} unit_bench;
+
 /* Main linked list for test cases */
 typedef struct unit_test_map
 {
@@ -36,9 +74,45 @@ typedef struct unit_test_map
   unit_test *list;
 } unit_test_list;
 
+/* A time limit (or baseline time) for one named test */
+typedef struct unit_timing
+{
+  char *name;
+  double ms;
+  struct unit_timing *next;
+} unit_timing;
+
+/* Options for timing the tests, set from the command line */
+typedef struct unit_options
+{
+  int repeat;          // Runs per test/benchmark (0 = default)
+  double budget_ms;    // Default time limit per test
+  double threshold;    // Allowed slowdown factor versus the baseline
+  double slack_ms;     // Extra time always allowed versus the baseline
+  char *save_baseline; // Where to write this run's medians, or NULL
+} unit_options;
+
 /* Global list of all test cases */
 unit_test_list ALL_TESTS = {0, NULL};
 
+/* Global list of all benchmarks */
+unit_bench *ALL_BENCHES = NULL;
+
+/* Per-test budgets from TEST_BUDGET() and times from the baseline file */
+unit_timing *UNIT_BUDGETS = NULL;
+unit_timing *UNIT_BASELINE = NULL;
+
+unit_options UNIT_OPTIONS = {0, 2000.0, 1.5, 5.0, NULL};
+
+/* Timer for the benchmark that is currently running */
+double unit_bench_start_ns = 0.0;
+double unit_bench_elapsed_ns = 0.0;
+int unit_bench_running = 0;
+
+/* Where TEST_FAIL() jumps back to while a test is running */
+jmp_buf unit_fail_jump;
+int unit_in_test = 0;
+
 /* Log things to stdout if verbose mode is on */
 void unit_log(const char *format, ...)
 {
@@ -48,16 +122,34 @@ void unit_log(const char *format, ...)
   va_end(args);
 }
 
-/* Log things to stdout if verbose mode is on */
+/* Report a failure and abandon the current test */
 void TEST_FAIL(const char *format, ...)
 {
   va_list args;
   va_start(args, format);
   vprintf(format, args);
   va_end(args);
+  if (unit_in_test)
+    longjmp(unit_fail_jump, 1);
   exit(1);
 }
 
+/* Current time in milliseconds, from a monotonic clock */
+double unit_now_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/* Current time in nanoseconds, from a monotonic clock */
+double unit_now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
 /* Find the test case given the name, NULL if doesn't exist */
 unit_test *unit_get_test(char *name)
 {
@@ -88,23 +180,231 @@ void unit_insert_test(char *name, void (*test_func)(void))
   cur->next = node;
 }
 
-/* Run test */
-void unit_run_test(unit_test *test)
+/* Add a named time to a list of timings */
+void unit_insert_timing(unit_timing **list, char *name, double ms)
 {
-  unit_log("[+] Running test: %s ... ", test->name);
+  unit_timing *node = (unit_timing *)calloc(sizeof(unit_timing), 1);
+  node->name = name;
+  node->ms = ms;
+  node->next = *list;
+  *list = node;
+}
+
+/* Find the time for the given name, or `fallback` if there isn't one */
+double unit_get_timing(unit_timing *list, char *name, double fallback)
+{
+  for (unit_timing *cur = list; cur != NULL; cur = cur->next)
+    if (strcmp(cur->name, name) == 0)
+      return cur->ms;
+  return fallback;
+}
+
+/* Read a baseline file with `test_name median_ms` lines */
+void unit_load_baseline(char *filename)
+{
+  FILE *f = fopen(filename, "r");
+  if (f == NULL)
+  {
+    fprintf(stderr, "Unable to open baseline file %s.\n", filename);
+    exit(1);
+  }
+  char name[256];
+  double ms;
+  while (fscanf(f, "%255s %lf", name, &ms) == 2)
+    unit_insert_timing(&UNIT_BASELINE, strdup(name), ms);
+  fclose(f);
+}
+
+/* Call a test once, returning 1 if it passed */
+int unit_call_test(unit_test *test)
+{
+  if (setjmp(unit_fail_jump) != 0)
+  {
+    unit_in_test = 0;
+    return 0;
+  }
+  unit_in_test = 1;
   test->test_func();
-  unit_log("Passed!\n");
+  unit_in_test = 0;
+  return 1;
 }
 
-/* Run all the tests */
-void unit_run_all_tests()
+int unit_compare_doubles(const void *a, const void *b)
 {
-  unit_test *cur = ALL_TESTS.list;
-  while (cur != NULL)
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* Run test, returning 1 if it passed. Its median time goes in `*median` */
+int unit_run_test(unit_test *test, double *median)
+{
+  int repeat = UNIT_OPTIONS.repeat;
+  double times[repeat];
+
+  unit_log("[+] Running test: %s ... ", test->name);
+  for (int i = 0; i < repeat; i++)
   {
-    unit_run_test(cur);
-    cur = cur->next;
+    double start = unit_now_ms();
+    if (!unit_call_test(test))
+      return 0;
+    times[i] = unit_now_ms() - start;
+  }
+
+  qsort(times, repeat, sizeof(double), unit_compare_doubles);
+  *median = times[repeat / 2];
+
+  double budget = unit_get_timing(UNIT_BUDGETS, test->name,
+                                  UNIT_OPTIONS.budget_ms);
+  double baseline = unit_get_timing(UNIT_BASELINE, test->name, -1.0);
+
+  if (*median > budget)
+  {
+    unit_log("Over budget! (%.2f ms, budget %.2f ms)\n", *median, budget);
+    return 0;
+  }
+  if (baseline >= 0 &&
+      *median > baseline * UNIT_OPTIONS.threshold + UNIT_OPTIONS.slack_ms)
+  {
+    unit_log("Regressed! (%.2f ms, baseline %.2f ms)\n", *median, baseline);
+    return 0;
+  }
+
+  if (repeat == 1)
+    unit_log("Passed! (%.2f ms)\n", *median);
+  else
+    unit_log("Passed! (median %.2f ms, min %.2f ms over %d runs)\n",
+             *median, times[0], repeat);
+  return 1;
+}
+
+/* Run all the tests (or just the one called `name`), returning the number
+ * of failures */
+int unit_run_tests(char *name)
+{
+  FILE *save = NULL;
+  if (UNIT_OPTIONS.save_baseline != NULL)
+  {
+    save = fopen(UNIT_OPTIONS.save_baseline, "w");
+    if (save == NULL)
+    {
+      fprintf(stderr, "Unable to open %s.\n", UNIT_OPTIONS.save_baseline);
+      exit(1);
+    }
+  }
+
+  int failed = 0;
+  for (unit_test *cur = ALL_TESTS.list; cur != NULL; cur = cur->next)
+  {
+    if (name != NULL && strcmp(cur->name, name) != 0)
+      continue;
+    double median;
+    if (!unit_run_test(cur, &median))
+      failed++;
+    else if (save != NULL)
+      fprintf(save, "%s %.3f\n", cur->name, median);
+  }
+
+  if (save != NULL)
+    fclose(save);
+  return failed;
+}
+
+/* Add a benchmark to the end of the list */
+void unit_insert_bench(char *name, void (*bench_func)(long))
+{
+  unit_bench *node = (unit_bench *)calloc(sizeof(unit_bench), 1);
+  node->name = name;
+  node->bench_func = bench_func;
+
+  unit_bench **cur = &ALL_BENCHES;
+  while (*cur != NULL)
+    cur = &(*cur)->next;
+  *cur = node;
+}
+
+/* Find the benchmark given the name, NULL if doesn't exist */
+unit_bench *unit_get_bench(char *name)
+{
+  for (unit_bench *cur = ALL_BENCHES; cur != NULL; cur = cur->next)
+    if (strcmp(cur->name, name) == 0)
+      return cur;
+  return NULL;
+}
+
+void unit_bench_start_timer()
+{
+  if (!unit_bench_running)
+  {
+    unit_bench_start_ns = unit_now_ns();
+    unit_bench_running = 1;
+  }
+}
+
+void unit_bench_stop_timer()
+{
+  if (unit_bench_running)
+  {
+    unit_bench_elapsed_ns += unit_now_ns() - unit_bench_start_ns;
+    unit_bench_running = 0;
+  }
+}
+
+void unit_bench_reset_timer()
+{
+  unit_bench_elapsed_ns = 0.0;
+  if (unit_bench_running)
+    unit_bench_start_ns = unit_now_ns();
+}
+
+/* Run the benchmark once for `n` ops, returning the time it took in ns */
+double unit_time_bench(unit_bench *bench, long n)
+{
+  unit_bench_elapsed_ns = 0.0;
+  unit_bench_running = 0;
+  unit_bench_start_timer();
+  bench->bench_func(n);
+  unit_bench_stop_timer();
+  return unit_bench_elapsed_ns;
+}
+
+/* Warm up, calibrate and run one benchmark */
+void unit_run_bench(unit_bench *bench)
+{
+  int repeat = UNIT_OPTIONS.repeat > 0 ? UNIT_OPTIONS.repeat : 5;
+  double per_op[repeat];
+
+  unit_log("[+] Bench %s ... ", bench->name);
+  fflush(stdout);
+
+  // Warm up, then grow the op count until a run takes at least 50 ms
+  long n = 1;
+  double ns = unit_time_bench(bench, n);
+  while (ns < 50e6 && n < 1000000000L)
+  {
+    long next = ns > 0 ? (long)(n * 60e6 / ns) : n * 100;
+    if (next > n * 100)
+      next = n * 100;
+    if (next <= n)
+      next = n + 1;
+    n = next;
+    ns = unit_time_bench(bench, n);
   }
+
+  for (int i = 0; i < repeat; i++)
+    per_op[i] = unit_time_bench(bench, n) / n;
+  qsort(per_op, repeat, sizeof(double), unit_compare_doubles);
+
+  double median = per_op[repeat / 2];
+  unit_log("%.2f ns/op (min %.2f), %.3g ops/sec [%ld ops x %d runs]\n",
+           median, per_op[0], 1e9 / median, n, repeat);
+}
+
+/* Run all the benchmarks, or just the one called `name` */
+void unit_run_benches(char *name)
+{
+  for (unit_bench *cur = ALL_BENCHES; cur != NULL; cur = cur->next)
+    if (name == NULL || strcmp(cur->name, name) == 0)
+      unit_run_bench(cur);
 }
 
 /* Free all associated data */
@@ -117,29 +417,95 @@ void unit_free_lists()
     free(cur);
     cur = temp;
   }
+
+  unit_bench *bench = ALL_BENCHES;
+  while (bench != NULL)
+  {
+    unit_bench *temp = bench->next;
+    free(bench);
+    bench = temp;
+  }
+
+  unit_timing *lists[] = {UNIT_BUDGETS, UNIT_BASELINE};
+  for (int i = 0; i < 2; i++)
+  {
+    unit_timing *t = lists[i];
+    while (t != NULL)
+    {
+      unit_timing *temp = t->next;
+      if (i == 1)
+        free(t->name);
+      free(t);
+      t = temp;
+    }
+  }
 }
 
 /**
  * Main function to handle running all tests. Should take in argc and argv
- * from `main()`. If no arguments are passed in, all tests are run.
+ * from `main()`. If no test name is passed in, all tests are run. Exits with
+ * status 1 if any test failed.
  */
 void unit_main(int argc, char **argv)
 {
-  if (argc == 1)
+  char *name = NULL;
+  int benchmarks = 0;
+
+  for (int i = 1; i < argc; i++)
   {
-    unit_run_all_tests();
+    int hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--repeat") == 0 && hasValue)
+      UNIT_OPTIONS.repeat = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--budget") == 0 && hasValue)
+      UNIT_OPTIONS.budget_ms = atof(argv[++i]);
+    else if (strcmp(argv[i], "--baseline") == 0 && hasValue)
+      unit_load_baseline(argv[++i]);
+    else if (strcmp(argv[i], "--threshold") == 0 && hasValue)
+      UNIT_OPTIONS.threshold = atof(argv[++i]);
+    else if (strcmp(argv[i], "--slack") == 0 && hasValue)
+      UNIT_OPTIONS.slack_ms = atof(argv[++i]);
+    else if (strcmp(argv[i], "--save-baseline") == 0 && hasValue)
+      UNIT_OPTIONS.save_baseline = argv[++i];
+    else if (strcmp(argv[i], "--bench") == 0)
+      benchmarks = 1;
+    else if (argv[i][0] == '-')
+    {
+      fprintf(stderr, "Unknown or incomplete option %s. Exiting.\n", argv[i]);
+      exit(1);
+    }
+    else
+      name = argv[i];
   }
-  else
+
+  if (benchmarks)
   {
-    unit_test *test = unit_get_test(argv[1]);
-    if (test == NULL)
+    if (name != NULL && unit_get_bench(name) == NULL)
     {
-      fprintf(stderr, "Test %s not found. Exiting.\n", argv[1]);
+      fprintf(stderr, "Benchmark %s not found. Exiting.\n", name);
       exit(1);
     }
-    unit_run_test(test);
+    unit_run_benches(name);
+    unit_free_lists();
+    unit_log("[+] Done.\n");
+    exit(0);
+  }
+
+  if (UNIT_OPTIONS.repeat < 1)
+    UNIT_OPTIONS.repeat = 1;
+
+  if (name != NULL && unit_get_test(name) == NULL)
+  {
+    fprintf(stderr, "Test %s not found. Exiting.\n", name);
+    exit(1);
   }
+
+  int failed = unit_run_tests(name);
   unit_free_lists();
+  if (failed > 0)
+  {
+    unit_log("[-] %d test(s) failed.\n", failed);
+    exit(1);
+  }
   unit_log("[+] Done.\n");
 }
 
@@ -151,10 +517,31 @@ void unit_main(int argc, char **argv)
   }                                                           \
   void unit_testcase_##name(void)
 
+/* Give the test `name` its own time limit instead of the --budget default */
+#define TEST_BUDGET(name, ms)                                        \
+  __attribute__((constructor)) void unit_budget_constructor_##name() \
+  {                                                                  \
+    unit_insert_timing(&UNIT_BUDGETS, #name, ms);                    \
+  }
+
+/* Declare a benchmark. The body should perform `bench_n` operations */
+#define BENCH(name)                                                 \
+  void unit_benchcase_##name(long bench_n);                         \
+  __attribute__((constructor)) void unit_bench_constructor_##name() \
+  {                                                                 \
+    unit_insert_bench(#name, unit_benchcase_##name);                \
+  }                                                                 \
+  void unit_benchcase_##name(long bench_n)
+
+/* Leave setup work out of a benchmark's timing */
+#define BENCH_RESET_TIMER() unit_bench_reset_timer()
+#define BENCH_STOP_TIMER() unit_bench_stop_timer()
+#define BENCH_START_TIMER() unit_bench_start_timer()
+
 /** If this flag is defined, use the default basic main function **/
 #ifdef UNITTEST_DEFAULT_MAIN
 int main(int argc, char **argv)
 {
   unit_main(argc, argv);
 }
-#endif
\ No newline at end of file
+#endif
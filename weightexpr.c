@@ -0,0 +1,488 @@
+#include "weightexpr.h"
+
+#include <ctype.h>
+
+/**
+ * Weight expressions let the weight function be chosen at run time, e.g.
+ *
+ *      sqrt((r1-r2)^2 + (g1-g2)^2 + (b1-b2)^2) + 0.01
+ *
+ * for similarColour(). An expression gives the cost of stepping from pixel
+ * `a` to pixel `b` in terms of:
+ *
+ *      r1 g1 b1    colour of pixel a          x1 y1    coordinates of a
+ *      r2 g2 b2    colour of pixel b          x2 y2    coordinates of b
+ *
+ * numbers, + - * / ^ (power), unary minus, parentheses, and the functions
+ * sqrt(e), abs(e), min(e, e, ...) and max(e, e, ...).
+ *
+ * The expression is parsed once into bytecode for a small stack machine.
+ * The bytecode is then run over batches of (a, b) pairs at a time, so each
+ * instruction is dispatched once per batch, and its inner loop over the
+ * batch is a plain array operation that the compiler vectorizes.
+ *
+ * Costs must never be negative, and it is up to the expression to ensure
+ * that (like for any WeightFunc).
+ */
+
+// Pairs evaluated together by weightExprEval()
+#define EXPR_BATCH 256
+
+// Deepest stack an expression may need
+#define EXPR_MAX_DEPTH 32
+
+enum
+{
+  OP_CONST,
+  OP_R1,
+  OP_G1,
+  OP_B1,
+  OP_R2,
+  OP_G2,
+  OP_B2,
+  OP_X1,
+  OP_Y1,
+  OP_X2,
+  OP_Y2,
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_DIV,
+  OP_POW,
+  OP_NEG,
+  OP_SQUARE,
+  OP_SQRT,
+  OP_ABS,
+  OP_MIN,
+  OP_MAX
+};
+
+/****************************** Compiler *************************************/
+
+typedef struct
+{
+  const char *text;
+  const char *pos;
+  WeightExpr *expr;
+  int depth;   // Stack depth after the instructions emitted so far
+  int failed;  // Set on the first error
+  char *error; // Where to describe it
+  int errorSize;
+  int capacity; // Number of ops expr->ops has room for
+} ExprParser;
+
+static void parseError(ExprParser *p, const char *message)
+{
+  if (!p->failed && p->error != NULL)
+    snprintf(p->error, p->errorSize, "%s at position %d", message,
+             (int)(p->pos - p->text));
+  p->failed = 1;
+}
+
+static void emit(ExprParser *p, int op, double value)
+{
+  // Stack effect of each instruction
+  if (op <= OP_Y2)
+    p->depth++;
+  else if (op <= OP_POW || op == OP_MIN || op == OP_MAX)
+    p->depth--;
+  if (p->depth > EXPR_MAX_DEPTH)
+    parseError(p, "Expression too deeply nested");
+  if (p->depth > p->expr->maxDepth)
+    p->expr->maxDepth = p->depth;
+
+  WeightExpr *e = p->expr;
+  if (e->numOps == p->capacity)
+  {
+    p->capacity = p->capacity ? 2 * p->capacity : 16;
+    e->ops = realloc(e->ops, sizeof(WeightOp) * p->capacity);
+    if (e->ops == NULL)
+    {
+      fprintf(stderr, "compileWeightExpr(): Out of memory.\n");
+      exit(1);
+    }
+  }
+  e->ops[e->numOps].op = op;
+  e->ops[e->numOps].value = value;
+  e->numOps++;
+}
+
+static void skipSpace(ExprParser *p)
+{
+  while (isspace((unsigned char)*p->pos))
+    p->pos++;
+}
+
+static int accept(ExprParser *p, char c)
+{
+  skipSpace(p);
+  if (*p->pos == c)
+  {
+    p->pos++;
+    return 1;
+  }
+  return 0;
+}
+
+static void parseSum(ExprParser *p);
+
+// Argument list of a function, after its name: ( e, e, ... )
+static int parseArguments(ExprParser *p)
+{
+  int count = 0;
+  if (!accept(p, '('))
+  {
+    parseError(p, "Expected '('");
+    return 0;
+  }
+  do
+  {
+    parseSum(p);
+    count++;
+  } while (!p->failed && accept(p, ','));
+  if (!accept(p, ')'))
+    parseError(p, "Expected ')'");
+  return count;
+}
+
+static void parsePrimary(ExprParser *p)
+{
+  static const struct
+  {
+    const char *name;
+    int op;
+  } variables[] = {{"r1", OP_R1}, {"g1", OP_G1}, {"b1", OP_B1},
+                   {"r2", OP_R2}, {"g2", OP_G2}, {"b2", OP_B2},
+                   {"x1", OP_X1}, {"y1", OP_Y1}, {"x2", OP_X2},
+                   {"y2", OP_Y2}};
+
+  skipSpace(p);
+  if (accept(p, '('))
+  {
+    parseSum(p);
+    if (!accept(p, ')'))
+      parseError(p, "Expected ')'");
+    return;
+  }
+
+  if (isdigit((unsigned char)*p->pos) || *p->pos == '.')
+  {
+    char *end;
+    double value = strtod(p->pos, &end);
+    p->pos = end;
+    emit(p, OP_CONST, value);
+    return;
+  }
+
+  if (!isalpha((unsigned char)*p->pos))
+  {
+    parseError(p, "Expected a number, variable or function");
+    return;
+  }
+
+  char name[16];
+  int len = 0;
+  while (isalnum((unsigned char)*p->pos) && len < 15)
+    name[len++] = *p->pos++;
+  name[len] = '\0';
+
+  for (int i = 0; i < (int)(sizeof(variables) / sizeof(variables[0])); i++)
+  {
+    if (strcmp(name, variables[i].name) == 0)
+    {
+      emit(p, variables[i].op, 0.0);
+      return;
+    }
+  }
+
+  if (strcmp(name, "sqrt") == 0 || strcmp(name, "abs") == 0)
+  {
+    if (parseArguments(p) != 1)
+      parseError(p, "Expected one argument");
+    emit(p, name[0] == 's' ? OP_SQRT : OP_ABS, 0.0);
+  }
+  else if (strcmp(name, "min") == 0 || strcmp(name, "max") == 0)
+  {
+    int count = parseArguments(p);
+    if (count < 2)
+      parseError(p, "Expected at least two arguments");
+    for (int i = 1; i < count; i++)
+      emit(p, name[1] == 'i' ? OP_MIN : OP_MAX, 0.0);
+  }
+  else
+  {
+    parseError(p, "Unknown variable or function");
+  }
+}
+
+static void parseUnary(ExprParser *p);
+
+// primary [^ unary]   (right associative, binds tighter than unary minus)
+static void parsePower(ExprParser *p)
+{
+  parsePrimary(p);
+  if (accept(p, '^'))
+  {
+    int start = p->expr->numOps;
+    parseUnary(p);
+    WeightExpr *e = p->expr;
+    if (e->numOps == start + 1 && e->ops[start].op == OP_CONST &&
+        e->ops[start].value == 2.0)
+    {
+      // x^2 is by far the most common power, so square without pow()
+      e->numOps--;
+      p->depth--;
+      emit(p, OP_SQUARE, 0.0);
+    }
+    else
+    {
+      emit(p, OP_POW, 0.0);
+    }
+  }
+}
+
+static void parseUnary(ExprParser *p)
+{
+  if (accept(p, '-'))
+  {
+    parseUnary(p);
+    emit(p, OP_NEG, 0.0);
+  }
+  else
+  {
+    parsePower(p);
+  }
+}
+
+static void parseProduct(ExprParser *p)
+{
+  parseUnary(p);
+  while (!p->failed)
+  {
+    if (accept(p, '*'))
+      parseUnary(p), emit(p, OP_MUL, 0.0);
+    else if (accept(p, '/'))
+      parseUnary(p), emit(p, OP_DIV, 0.0);
+    else
+      break;
+  }
+}
+
+static void parseSum(ExprParser *p)
+{
+  parseProduct(p);
+  while (!p->failed)
+  {
+    if (accept(p, '+'))
+      parseProduct(p), emit(p, OP_ADD, 0.0);
+    else if (accept(p, '-'))
+      parseProduct(p), emit(p, OP_SUB, 0.0);
+    else
+      break;
+  }
+}
+
+/**
+ * Compile the given weight expression. Returns NULL if it is not valid, in
+ * which case a description of the problem is written to `error` (if it is
+ * not NULL).
+ */
+WeightExpr *compileWeightExpr(const char *text, char *error, int errorSize)
+{
+  WeightExpr *expr = calloc(sizeof(WeightExpr), 1);
+  if (expr == NULL)
+  {
+    fprintf(stderr, "compileWeightExpr(): Out of memory.\n");
+    exit(1);
+  }
+
+  ExprParser p = {text, text, expr, 0, 0, error, errorSize};
+  parseSum(&p);
+  skipSpace(&p);
+  if (!p.failed && *p.pos != '\0')
+    parseError(&p, "Unexpected character");
+
+  if (p.failed)
+  {
+    freeWeightExpr(expr);
+    return NULL;
+  }
+  return expr;
+}
+
+void freeWeightExpr(WeightExpr *expr)
+{
+  if (expr)
+    free(expr->ops);
+  free(expr);
+}
+
+/****************************** Evaluator ************************************/
+
+/**
+ * Evaluate the expression for the `n` steps (a + i) -> (b + i), storing the
+ * costs in out[i]. The pairs are processed EXPR_BATCH at a time.
+ */
+void weightExprEval(WeightExpr *expr, Image *im, int a, int b, int n,
+                    double out[])
+{
+  double stack[EXPR_MAX_DEPTH + 1][EXPR_BATCH];
+
+  for (int start = 0; start < n; start += EXPR_BATCH)
+  {
+    int count = n - start < EXPR_BATCH ? n - start : EXPR_BATCH;
+    const Pixel *pa = &im->data[a + start];
+    const Pixel *pb = &im->data[b + start];
+    int top = -1;
+
+    for (int k = 0; k < expr->numOps; k++)
+    {
+      WeightOp op = expr->ops[k];
+      double *restrict s = stack[op.op <= OP_Y2 ? top + 1 : top];
+      double *restrict t = stack[top > 0 ? top - 1 : 0];
+
+      switch (op.op)
+      {
+      case OP_CONST:
+        for (int i = 0; i < count; i++)
+          s[i] = op.value;
+        break;
+      case OP_R1:
+        for (int i = 0; i < count; i++)
+          s[i] = pa[i].R;
+        break;
+      case OP_G1:
+        for (int i = 0; i < count; i++)
+          s[i] = pa[i].G;
+        break;
+      case OP_B1:
+        for (int i = 0; i < count; i++)
+          s[i] = pa[i].B;
+        break;
+      case OP_R2:
+        for (int i = 0; i < count; i++)
+          s[i] = pb[i].R;
+        break;
+      case OP_G2:
+        for (int i = 0; i < count; i++)
+          s[i] = pb[i].G;
+        break;
+      case OP_B2:
+        for (int i = 0; i < count; i++)
+          s[i] = pb[i].B;
+        break;
+      case OP_X1:
+      case OP_Y1:
+      case OP_X2:
+      case OP_Y2:
+      {
+        int base = (op.op == OP_X1 || op.op == OP_Y1 ? a : b) + start;
+        int wantX = op.op == OP_X1 || op.op == OP_X2;
+        for (int i = 0; i < count; i++)
+          s[i] = wantX ? (base + i) % im->sx : (base + i) / im->sx;
+        break;
+      }
+      case OP_ADD:
+        for (int i = 0; i < count; i++)
+          t[i] = t[i] + s[i];
+        break;
+      case OP_SUB:
+        for (int i = 0; i < count; i++)
+          t[i] = t[i] - s[i];
+        break;
+      case OP_MUL:
+        for (int i = 0; i < count; i++)
+          t[i] = t[i] * s[i];
+        break;
+      case OP_DIV:
+        for (int i = 0; i < count; i++)
+          t[i] = t[i] / s[i];
+        break;
+      case OP_POW:
+        for (int i = 0; i < count; i++)
+          t[i] = pow(t[i], s[i]);
+        break;
+      case OP_MIN:
+        for (int i = 0; i < count; i++)
+          t[i] = s[i] < t[i] ? s[i] : t[i];
+        break;
+      case OP_MAX:
+        for (int i = 0; i < count; i++)
+          t[i] = s[i] > t[i] ? s[i] : t[i];
+        break;
+      case OP_NEG:
+        for (int i = 0; i < count; i++)
+          s[i] = -s[i];
+        break;
+      case OP_SQUARE:
+        for (int i = 0; i < count; i++)
+          s[i] = s[i] * s[i];
+        break;
+      case OP_SQRT:
+        for (int i = 0; i < count; i++)
+          s[i] = sqrt(s[i]);
+        break;
+      case OP_ABS:
+        for (int i = 0; i < count; i++)
+          s[i] = fabs(s[i]);
+        break;
+      }
+
+      if (op.op <= OP_Y2)
+        top++;
+      else if (op.op <= OP_POW || op.op == OP_MIN || op.op == OP_MAX)
+        top--;
+    }
+
+    memcpy(&out[start], stack[0], sizeof(double) * count);
+  }
+}
+
+/**
+ * Evaluate the expression for every step in the image, one row at a time,
+ * and store the costs in im->weightGrid for use with gridWeight().
+ */
+void buildWeightGrid(Image *im, WeightExpr *expr)
+{
+  int sx = im->sx, sy = im->sy;
+  double *grid = malloc(sizeof(double) * 4 * (size_t)sx * sy);
+  double *row = malloc(sizeof(double) * sx);
+  if (grid == NULL || row == NULL)
+  {
+    fprintf(stderr, "buildWeightGrid(): Out of memory.\n");
+    exit(1);
+  }
+
+  for (size_t i = 0; i < (size_t)4 * sx * sy; i++)
+    grid[i] = INFINITY;
+
+  for (int y = 0; y < sy; y++)
+  {
+    int p = y * sx;
+
+    weightExprEval(expr, im, p, p + 1, sx - 1, row);
+    for (int x = 0; x < sx - 1; x++)
+      grid[(size_t)4 * (p + x) + CHAIN_RIGHT] = row[x];
+
+    weightExprEval(expr, im, p + 1, p, sx - 1, row);
+    for (int x = 1; x < sx; x++)
+      grid[(size_t)4 * (p + x) + CHAIN_LEFT] = row[x - 1];
+
+    if (y < sy - 1)
+    {
+      weightExprEval(expr, im, p, p + sx, sx, row);
+      for (int x = 0; x < sx; x++)
+        grid[(size_t)4 * (p + x) + CHAIN_DOWN] = row[x];
+    }
+    if (y > 0)
+    {
+      weightExprEval(expr, im, p, p - sx, sx, row);
+      for (int x = 0; x < sx; x++)
+        grid[(size_t)4 * (p + x) + CHAIN_UP] = row[x];
+    }
+  }
+
+  free(row);
+  free(im->weightGrid);
+  im->weightGrid = grid;
+}
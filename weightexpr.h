@@ -0,0 +1,27 @@
+#ifndef __WEIGHTEXPR_H__
+#define __WEIGHTEXPR_H__
+
+#include "marcher.h"
+
+// One instruction of a compiled weight expression (see weightexpr.c)
+typedef struct
+{
+  int op;
+  double value; // Constant for OP_CONST
+} WeightOp;
+
+// A weight expression compiled to stack-machine bytecode
+typedef struct
+{
+  int numOps;
+  int maxDepth; // Deepest the stack gets while evaluating
+  WeightOp *ops;
+} WeightExpr;
+
+WeightExpr *compileWeightExpr(const char *text, char *error, int errorSize);
+void weightExprEval(WeightExpr *expr, Image *im, int a, int b, int n,
+                    double out[]);
+void buildWeightGrid(Image *im, WeightExpr *expr);
+void freeWeightExpr(WeightExpr *expr);
+
+#endif // __WEIGHTEXPR_H__